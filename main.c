@@ -13,6 +13,12 @@
 #include "sim.h"
 
 #define TRIALS 10000
+#ifndef OPT_TRIALS
+#define OPT_TRIALS 0 //first trials also solved exactly for rerouting (solve_traces), 0 to skip
+#endif
+#ifndef GAP_STATS
+#define GAP_STATS 0 //1 to also report relay gain lost to weighted assignment (a Hungarian solve per timestep)
+#endif
 
 int main(int argc, char *argv[]) {
     if (argc != 9) {
@@ -23,7 +29,7 @@ int main(int argc, char *argv[]) {
                                 %%ui[AP y-coordinate] \
                                 %%f[AP Height] \
                                 %%ui[Time Step] \
-                                %%ui[Num AP - Not Implemented]\n");
+                                %%ui[Num AP]\n");
         return 1;
     }
     
@@ -42,14 +48,19 @@ int main(int argc, char *argv[]) {
     int ap_y = atoi(argv[5]);
     double ap_height = atof(argv[6]);
     int timestep = atoi(argv[7]);
-    if (timestep > 200) {
-        fprintf(stderr, "Number of timesteps must be 200 or less\n");
+    if (timestep < 1) {
+        fprintf(stderr, "Number of timesteps must be positive\n");
+        return 1;
+    }
+    int num_ap = atoi(argv[8]);
+    if (num_ap < 1 || num_ap > MAX_AP) {
+        fprintf(stderr, "Number of APs must be between 1 and %d\n", MAX_AP);
         return 1;
     }
-    int num_mirrors = atoi(argv[8]);
     int region = 4;
     time_t t;
     srand((unsigned) time(&t));
+    seed_shadow((unsigned long long) t);
     
     int group_size[6] = {1, 2, 4, 5, 8, 10};
     for (int i = 0; i < 6; i++) {
@@ -57,11 +68,13 @@ int main(int argc, char *argv[]) {
             break;
         }
         fprintf(stdout, "Group Size:\n%d\n", group_size[i]);
-        double capacity[MAXT] = {0};
-        double delay[MAXT] = {0};
-        double stability[MAXT] = {0};
-        double fair[MAXT] = {0};
-        double reach[MAXT] = {0};
+        struct series capacity, delay, stability, fair, reach, gap;
+        init_series(&capacity, timestep);
+        init_series(&delay, timestep);
+        init_series(&stability, timestep);
+        init_series(&fair, timestep);
+        init_series(&reach, timestep);
+        init_series(&gap, timestep);
         double count = 0;
         double count2 = 0;
         double through_all[MAX_NODE] = {0};
@@ -70,6 +83,13 @@ int main(int argc, char *argv[]) {
         double latency[MAX_NODE] = {0};
         double through_max[MAX_NODE] = {0};
         double latency_max[MAX_NODE] = {0};
+        double ap_capacity[MAX_AP] = {0};
+        double ap_served[MAX_AP] = {0};
+        struct graph *arena = alloc_graph(num);
+        struct graph *lookahead = alloc_graph(num); //scratch for sort_parent_predicted
+        alloc_mirrors(arena, num_ap);
+        alloc_mirrors(lookahead, num_ap);
+        struct trace *traces = OPT_TRIALS > 0 ? malloc(sizeof(struct trace) * OPT_TRIALS) : NULL;
         for (int x = 0; x < TRIALS; x++) {
             int fail = 0;
             struct node *sorth[MAX_NODE] = {0};
@@ -88,7 +108,8 @@ int main(int argc, char *argv[]) {
              */
             
             //struct graph *graph = generate_graph_unif(width, length, ap_x, ap_y, num, ap_height);
-            struct graph *graph = generate_graph_group(width, length, ap_x, ap_y, ap_height, num, group_size[i]);
+            //struct graph *graph = generate_graph_group(width, length, ap_x, ap_y, ap_height, num, group_size[i]);
+            struct graph *graph = regenerate_graph_group(arena, width, length, ap_x, ap_y, ap_height, group_size[i]);
             fill_group(graph, group_size[i]);
             sort_group_capacity(graph);
             //sort_group_distance(graph);
@@ -114,16 +135,32 @@ int main(int argc, char *argv[]) {
             //ret = greedy_matching_depth2(graph, ret, 0);
 
             //ret = maximal_matching(graph, 0);
+            //ret = maximal_matching_hk(graph, 0);
+            //ret = relay_routing(graph, 3, 0, 0);
+            //ret = b_matching(graph, 2, 0);
+            //ret = blossom_matching(graph, 0);
 
             ret = group_matching(graph, 0);
             
             //ret = stable_matching(graph, 0);
+            //ret = parallel_stable_matching(graph, 0);
+            
+            //ret = weighted_matching(graph, 0);
+            //ret = auction_matching(graph, 0);
             
             //------------Update-Statistics--------------
             
+            if (x < OPT_TRIALS) {
+                init_trace(&traces[x]);
+                record_step(&traces[x], graph, 0);
+            }
+            if (GAP_STATS) {
+                add_series(&gap, 0, weighted_gap(graph));
+            }
             update_capacity_delay(graph, 0);
-            capacity[0] += get_capacity(graph);
-            delay[0] += get_delay(graph);
+            add_ap_stats(graph, 0, ap_capacity, ap_served);
+            add_series(&capacity, 0, get_capacity(graph));
+            add_series(&delay, 0, get_delay(graph));
             for (int y = 0; y < num; y++) {
                 temp_ta[y] += sorth[y]->capacity;
                 temp_la[y] += sorth[y]->delay;
@@ -132,12 +169,14 @@ int main(int argc, char *argv[]) {
             if (((int)(ret + 0.5)) > 0) {
                 fail = 1;
             }
-            fair[0] += get_stabl(graph);
+            add_series(&fair, 0, get_stabl(graph));
             if (fail == 1) {
-                reach[0] += get_reach(graph);
+                add_series(&reach, 0, get_reach(graph));
             }
+            double rerouted = 0;
             //-----------Simulate Node Mobility-----------
             for (int y = 1; y < timestep; y++) {
+                begin_timestep(graph, y);
                 //-----------Update-Graph------------------
                 update_graph_waypoint_group(width, length, graph); //random waypoint group
                 //shift_index(graph);
@@ -156,6 +195,7 @@ int main(int argc, char *argv[]) {
                 //find_parents(graph);
                 find_distance(graph);
                 sort_parent_capacity(graph);
+                //sort_parent_predicted(width, length, graph, lookahead);
                 //sort_parent_distance(graph);
                 
                 //---------Fair&Stable-Matching-Algorithms------------
@@ -164,7 +204,10 @@ int main(int argc, char *argv[]) {
                 //ret = update_greedy_stable(graph, y);
 
                 //ret = update_perfect(graph, y);
+                //ret = update_perfect_hk(graph, y);
+                //ret = update_perfect_dynamic(graph, y);
                 //ret = update_perfect_stable(graph, y);
+                //ret = update_perfect_stable_dynamic(graph, y);
 
                 //ret = update_stable(graph, ret, y);
                 //ret = update_stable_stable(graph, ret, y);
@@ -181,27 +224,45 @@ int main(int argc, char *argv[]) {
                 //ret = greedy_matching_depth2(graph, ret, y);
              
                 //ret = maximal_matching(graph, y);
+                //ret = maximal_matching_hk(graph, y);
+                //ret = relay_routing(graph, 3, 0, y);
+                //ret = b_matching(graph, 2, y);
+                //ret = blossom_matching(graph, y);
 
                 //ret = group_matching_fair(graph, y);
                 //ret = group_matching(graph , y);
                 
                 //ret = stable_matching(graph, y);
                 //ret = stable_matching_fair(graph, y);
+                //ret = parallel_stable_matching(graph, y);
+                
+                //ret = weighted_matching(graph, y);
+                //ret = auction_matching(graph, y);
+                //ret = update_weighted(graph, y); //with reset/find_parents above
                 
                 //----------Update-Statistics-----------
                 if (((int)(ret + 0.5)) > 0) {
                     fail = 1;
                 }
+                if (x < OPT_TRIALS) {
+                    record_step(&traces[x], graph, y);
+                }
+                if (GAP_STATS) {
+                    add_series(&gap, y, weighted_gap(graph));
+                }
                 update_capacity_delay(graph, y);
-                capacity[y] += get_capacity(graph);
-                delay[y] += get_delay(graph);
+                add_ap_stats(graph, y, ap_capacity, ap_served);
+                add_series(&capacity, y, get_capacity(graph));
+                add_series(&delay, y, get_delay(graph));
                 for (int z = 0; z < num; z++) {
                     temp_ta[z] += sorth[z]->capacity;
                     temp_la[z] += sorth[z]->delay;
                 }
                 
-                stability[y] += calc_stability(graph, y);
-                fair[y] += get_stabl(graph);
+                double total = calc_stability(graph, y);
+                add_series(&stability, y, total - rerouted);
+                rerouted = total;
+                add_series(&fair, y, get_stabl(graph));
                 if (fail == 1) {
                     double tt = get_reach(graph);/*
                     if (tt > 10) {
@@ -213,7 +274,7 @@ int main(int argc, char *argv[]) {
                             }
                         }
                     }*/
-                    reach[y] += tt;
+                    add_series(&reach, y, tt);
                 }
             }
             //------Update-throughput-latency-all-trials-----------
@@ -240,33 +301,22 @@ int main(int argc, char *argv[]) {
                     latency_max[y] = temp_la[y]/timestep;
                 }
             }
-            
-            destroy_resources(graph);
         }
+        destroy_resources(arena);
+        destroy_resources(lookahead);
         
         //---------Print-Statistics---------
         
         //----------Stability-Statistics-----------
+        //Sessions longer than WINDOW timesteps print one average per span timesteps
         fprintf(stdout, "Average Rerouting per Timestep:\n");
-        for (int y = 0; y < timestep; y++) {
-            if (y == 0) {
-                fprintf(stdout, "%.4f,", stability[y] / TRIALS);
-            } else {
-                fprintf(stdout, "%.4f,", (stability[y] - stability[y-1]) / TRIALS);
-            }
-        }
+        write_series(stdout, &stability, TRIALS, 1);
         fprintf(stdout, "\nMax Rerouting per Node:\n");
-        for (int y = 0; y < timestep; y++) {
-            fprintf(stdout, "%.4f,", fair[y] / TRIALS);
-        }
+        write_series(stdout, &fair, TRIALS, 1);
         fprintf(stdout, "\nAverage HMD Data Rate per timestep (Gbps):\n");
-        for (int y = 0; y < timestep; y++) {
-            fprintf(stdout, "%.4f,", capacity[y] / TRIALS / 1000000000);
-        }
+        write_series(stdout, &capacity, TRIALS, 1000000000);
         fprintf(stdout, "\nAverage Delay Network (ms):\n");
-        for (int y = 0; y < timestep; y++) {
-            fprintf(stdout, "%.4f,", delay[y] / TRIALS);
-        }
+        write_series(stdout, &delay, TRIALS, 1);
         fprintf(stdout, "\nAverage HMD Data Rate per Node over all timestep (Gbps):\n");
         for (int y = 0; y < num; y++) {
             fprintf(stdout, "%.4f,", through_all[y] / TRIALS / 1000000000);
@@ -276,13 +326,23 @@ int main(int argc, char *argv[]) {
             fprintf(stdout, "%.4f,", latency_all[y] / TRIALS);
         }
         
+        //---------------Per-AP-Statistics----------------
+        if (num_ap > 1) {
+            fprintf(stdout, "\nAverage HMD Data Rate served per AP per timestep (Gbps):\n");
+            for (int y = 0; y < num_ap; y++) {
+                fprintf(stdout, "%.4f,", ap_capacity[y] / TRIALS / timestep / 1000000000);
+            }
+            fprintf(stdout, "\nAverage Nodes served per AP per timestep:\n");
+            for (int y = 0; y < num_ap; y++) {
+                fprintf(stdout, "%.4f,", ap_served[y] / TRIALS / timestep);
+            }
+        }
+        
         //---------------Trials-with-Matching-Failures----------------
         fprintf(stdout, "\nMatching Failure:\n%.2f\n", count / TRIALS * 100);
         if (count > 0) {
             fprintf(stdout, "Max Unreachable count per Node in trials with Matching Failures:\n");
-            for (int y = 0; y < timestep; y++) {
-                fprintf(stdout, "%.4f,", reach[y] / count);
-            }
+            write_series(stdout, &reach, count, 1);
             fprintf(stdout, "\nAverage HMD Data Rate per Node in trials with Matching Failures (Gbps):\n");
             for (int y = 0; y < num; y++) {
                 fprintf(stdout, "%.4f,", through[y] / count / 1000000000);
@@ -305,6 +365,25 @@ int main(int argc, char *argv[]) {
                 fprintf(stdout, "%.4f,", latency_max[y]);
             }
         }
+        
+        //-------------Weighted-Assignment-Gap---------------
+        if (GAP_STATS) {
+            fprintf(stdout, "\nAverage Relay Gain Lost to Weighted Assignment per timestep (Gbps):\n");
+            write_series(stdout, &gap, TRIALS, 1);
+        }
+        
+        //-------------Exact-Rerouting-Baseline---------------
+        if (OPT_TRIALS > 0) {
+            int *opt = malloc(sizeof(int) * OPT_TRIALS);
+            solve_traces(traces, OPT_TRIALS, opt);
+            fprintf(stdout, "\nRerouting to LOS parents over the first %d timesteps above optimal per trial (-1 not solved):\n", TRACE_STEPS);
+            for (int y = 0; y < OPT_TRIALS; y++) {
+                int own = matcher_reroutes(&traces[y]);
+                fprintf(stdout, "%d,", opt[y] < 0 || own < 0 ? -1 : own - opt[y]);
+            }
+            free(opt);
+            free(traces);
+        }
         fprintf(stdout, "\n\n");
     }
     
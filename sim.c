@@ -30,6 +30,11 @@
 #define BLOCK 295
 #define BEACON 25
 
+//checked, marked and traversed store (epoch << 2 | value), a flag only counts while its epoch is current
+#define FLAG(f, e) (((unsigned int) (f) >> 2) == (e) ? (f) & 3 : 0)
+#define STAMP(v, e) ((int) ((e) << 2 | (v)))
+#define EPOCH_LIMIT (1u << 29)
+
 double gaussrand() {
     static double V1, V2, S;
     static int phase = 0;
@@ -54,26 +59,211 @@ double gaussrand() {
     return X;
 }
 
+//Counter-based shadowing stream: sample i of a run is a pure function of (key, i), so a
+//whole batch comes from one branch-free Box-Muller loop the compiler can vectorize (-O3,
+//plus -ffast-math for a vector libm) rather than a rejection loop per link. Building with
+//-DSHADOW_STREAM makes calc_capacity draw its shadowing from here instead of gaussrand.
+#define SHADOW_BATCH 256 //samples made per refill, even
+
+static unsigned long long shadow_key = 0x9e3779b97f4a7c15ull;
+static unsigned long long shadow_counter = 0;
+static double shadow_pool[SHADOW_BATCH];
+static int shadow_next = SHADOW_BATCH;
+
+void seed_shadow(unsigned long long key) {
+    shadow_key = key;
+    shadow_counter = 0;
+    shadow_next = SHADOW_BATCH;
+}
+
+//splitmix64 finalizer
+static inline unsigned long long mix64(unsigned long long z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+//Next n (even) samples of DEV * N(0, 1) into out, the cosine halves of the pairs first
+void fill_shadow(double *out, int n) {
+    unsigned long long base = shadow_counter;
+    int half = n / 2;
+    for (int i = 0; i < half; i++) {
+        unsigned long long a = mix64(shadow_key + (base + 2 * i) * 0x9e3779b97f4a7c15ull);
+        unsigned long long b = mix64(shadow_key + (base + 2 * i + 1) * 0x9e3779b97f4a7c15ull);
+        double u1 = (double) ((a >> 11) + 1) * 0x1.0p-53; //(0, 1]
+        double u2 = (double) (b >> 11) * 0x1.0p-53; //[0, 1)
+        double r = DEV * sqrt(-2 * log(u1));
+        out[i] = r * cos(2 * PI * u2);
+        out[half + i] = r * cos(2 * PI * u2 - PI / 2); //sin, kept apart from cos so no sincos call
+    }
+    shadow_counter = base + n;
+}
+
+double shadow_sample(void) {
+    if (shadow_next == SHADOW_BATCH) {
+        fill_shadow(shadow_pool, SHADOW_BATCH);
+        shadow_next = 0;
+    }
+    return shadow_pool[shadow_next++];
+}
+
 double distance(struct node *node1, struct node *node2) {
     return sqrt(pow(node2->x - node1->x, 2) + pow(node2->y - node1->y, 2) + pow(node2->height - node1->height, 2));
 }
 
+//Clearing a flag for every node is a single epoch increment, nodes are only walked when the epoch wraps
+void clear_checked(struct graph *graph) {
+    if (++graph->epoch_checked == EPOCH_LIMIT) {
+        graph->epoch_checked = 0;
+        graph->AP.checked = 0;
+        for (int x = 0; x < graph->population; x++) {
+            graph->people[x].checked = 0;
+        }
+    }
+}
+
+void clear_marked(struct graph *graph) {
+    if (++graph->epoch_marked == EPOCH_LIMIT) {
+        graph->epoch_marked = 0;
+        graph->AP.marked = 0;
+        for (int x = 0; x < graph->population; x++) {
+            graph->people[x].marked = 0;
+        }
+    }
+}
+
+void clear_traversed(struct graph *graph) {
+    if (++graph->epoch_traversed == EPOCH_LIMIT) {
+        graph->epoch_traversed = 0;
+        graph->AP.traversed = 0;
+        for (int x = 0; x < graph->population; x++) {
+            graph->people[x].traversed = 0;
+        }
+    }
+}
+
+void nodeset_clear(struct nodeset *set) {
+    memset(set->word, 0, sizeof(set->word));
+}
+
+void nodeset_add(struct nodeset *set, int id) {
+    set->word[id >> 6] |= 1ULL << (id & 63);
+}
+
+void nodeset_remove(struct nodeset *set, int id) {
+    set->word[id >> 6] &= ~(1ULL << (id & 63));
+}
+
+int nodeset_has(struct nodeset *set, int id) {
+    return (set->word[id >> 6] >> (id & 63)) & 1;
+}
+
+//ret = a & b, returns number of members in ret
+int nodeset_and(struct nodeset *ret, struct nodeset *a, struct nodeset *b) {
+    int count = 0;
+    for (int i = 0; i < SET_WORDS; i++) {
+        ret->word[i] = a->word[i] & b->word[i];
+        count += __builtin_popcountll(ret->word[i]);
+    }
+    return count;
+}
+
+//Lowest id in set, -1 if empty
+int nodeset_first(struct nodeset *set) {
+    for (int i = 0; i < SET_WORDS; i++) {
+        if (set->word[i] != 0) {
+            return (i << 6) + __builtin_ctzll(set->word[i]);
+        }
+    }
+    return -1;
+}
+
+//Lowest id >= from in set, -1 if none
+int nodeset_next(struct nodeset *set, int from) {
+    for (int i = from >> 6; i < SET_WORDS; i++) {
+        unsigned long long word = set->word[i];
+        if (i == from >> 6) {
+            word &= ~0ULL << (from & 63);
+        }
+        if (word != 0) {
+            return (i << 6) + __builtin_ctzll(word);
+        }
+    }
+    return -1;
+}
+
+void add_parent(struct node *node, struct node *parent) {
+    nodeset_add(&node->parents, parent->id);
+    node->parent[node->num_parent++] = parent;
+}
+
+void clear_parents(struct node *node) {
+    nodeset_clear(&node->parents);
+    node->num_parent = 0;
+}
+
+//Index in node->parent of the most preferred parent that is in set, -1 if none
+int first_parent_in(struct graph *graph, struct node *node, struct nodeset *set) {
+    struct nodeset both;
+    int count = nodeset_and(&both, &node->parents, set);
+    if (count == 0) {
+        return -1;
+    }
+    int id = nodeset_first(&both);
+    for (int y = 0; y < node->num_parent; y++) {
+        if (count == 1) {
+            if (node->parent[y] == &graph->people[id]) {
+                return y;
+            }
+        } else if (nodeset_has(&both, (int) (node->parent[y] - graph->people))) {
+            return y;
+        }
+    }
+    return -1;
+}
+
+//A LOS node is a free parent when it has no child (and is not keeping a link if skip_checked)
+void update_free(struct graph *graph, struct node *node, int skip_checked) {
+    if (nodeset_has(&graph->los, node->id) && node->num_child == 0 &&
+        (skip_checked == 0 || FLAG(node->checked, graph->epoch_checked) == 0)) {
+        nodeset_add(&graph->free, node->id);
+    } else {
+        nodeset_remove(&graph->free, node->id);
+    }
+}
+
+void find_free(struct graph *graph, int skip_checked) {
+    nodeset_clear(&graph->free);
+    for (int x = 0; x < graph->AP.num_child; x++) {
+        update_free(graph, graph->AP.child[x], skip_checked);
+    }
+}
+
+//Link arrays are only read below their counts, so resetting the counts is enough.
+//Building with -DSANITIZE fills them with garbage instead so a read past a count shows up.
+void init_links(struct node *node) {
+    node->num_child = 0;
+    node->num_blockers = 0;
+    clear_parents(node);
+    memset(node->pp, 0, sizeof(node->pp));
+#ifdef SANITIZE
+    memset(node->child, 0xa5, sizeof(node->child));
+    memset(node->blockers, 0xa5, sizeof(node->blockers));
+    memset(node->parent, 0xa5, sizeof(node->parent));
+    memset(node->distance, 0xa5, sizeof(node->distance));
+    memset(node->distance_group, 0xa5, sizeof(node->distance_group));
+#endif
+}
+
 void init_node(struct node *coordinate[WIDTH][LENGTH], struct node *node, int x, int y) {
     node->person = 1;
     node->x = x;
     node->y = y;
     coordinate[x][y] = node;
     node->height = ((double) (rand() % 81)) / 100 + MIN_HEIGHT;
-    node->num_child = 0;
-    node->num_blockers = 0;
-    node->num_parent = 0;
+    init_links(node);
     node->traversed = 0;
     node->idx = 0;
-    memset(node->child, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->blockers, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->parent, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->distance, 0, sizeof(double) * MAX_NODE);
-    memset(node->pp, 0, sizeof(struct node *) * MAXT);
     node->blocked = 0;
     node->stability = 0;
     node->checked = 0;
@@ -93,17 +283,9 @@ void init_node_group(int width, int length, struct node *coordinate[WIDTH][LENGT
     node->y = y;
     coordinate[x][y] = node;
     node->height = ((double) (rand() % 81)) / 100 + MIN_HEIGHT;
-    node->num_child = 0;
-    node->num_blockers = 0;
-    node->num_parent = 0;
+    init_links(node);
     node->traversed = 0;
     node->idx = 0;
-    memset(node->child, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->blockers, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->parent, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->distance, 0, sizeof(double) * MAX_NODE);
-    memset(node->distance_group, 0, sizeof(double) * MAX_GROUP);
-    memset(node->pp, 0, sizeof(struct node *) * MAXT);
     node->blocked = 0;
     node->stability = 0;
     node->checked = 0;
@@ -143,17 +325,9 @@ void init_node_group(int width, int length, struct node *coordinate[WIDTH][LENGT
         }
 
         node2->height = ((double) (rand() % 81)) / 100 + MIN_HEIGHT;
-        node2->num_child = 0;
-        node2->num_blockers = 0;
-        node2->num_parent = 0;
+        init_links(node2);
         node2->traversed = 0;
         node2->idx = 0;
-        memset(node2->child, 0, sizeof(struct node *) * MAX_NODE);
-        memset(node2->blockers, 0, sizeof(struct node *) * MAX_NODE);
-        memset(node2->parent, 0, sizeof(struct node *) * MAX_NODE);
-        memset(node2->distance, 0, sizeof(double) * MAX_NODE);
-        memset(node2->distance_group, 0, sizeof(double) * MAX_GROUP);
-        memset(node2->pp, 0, sizeof(struct node *) * MAXT);
         node2->blocked = 0;
         node2->stability = 0;
         node2->checked = 0;
@@ -192,17 +366,9 @@ void init_node_poisson(int length, int width, struct node *coordinate[WIDTH][LEN
         }
     }
     node->height = ((double) (rand() % 81)) / 100 + MIN_HEIGHT;
-    node->num_child = 0;
-    node->num_blockers = 0;
-    node->num_parent = 0;
+    init_links(node);
     node->traversed = 0;
     node->idx = 0;
-    memset(node->child, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->blockers, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->parent, 0, sizeof(struct node *) * MAX_NODE);
-    memset(node->distance, 0, sizeof(double) * MAX_NODE);
-    memset(node->distance_group, 0, sizeof(double) * MAX_GROUP);
-    memset(node->pp, 0, sizeof(struct node *) * MAXT);
     node->blocked = 0;
     node->stability = 0;
     node->checked = 0;
@@ -227,6 +393,9 @@ struct graph *generate_graph_unif(int width, int length, int ap_x, int ap_y, int
     ret->population = population;
     ret->coordinate[ap_x][ap_y] = &(ret->AP);
     ret->num_mirrors = 0;
+    ret->epoch_checked = 0;
+    ret->epoch_marked = 0;
+    ret->epoch_traversed = 0;
     
     ret->AP.person = 0;
     ret->AP.x = ap_x;
@@ -234,9 +403,9 @@ struct graph *generate_graph_unif(int width, int length, int ap_x, int ap_y, int
     ret->AP.height = ap_height;
     ret->AP.blocked = 0;
     ret->AP.num_child = 0;
-    ret->AP.num_parent = 0;
+    clear_parents(&ret->AP);
     ret->AP.num_blockers = 0;
-    ret->AP.num_parent = 0;
+    clear_parents(&ret->AP);
     ret->AP.traversed = 0;
     ret->AP.stability = 0;
     ret->AP.checked = 0;
@@ -245,13 +414,14 @@ struct graph *generate_graph_unif(int width, int length, int ap_x, int ap_y, int
     ret->AP.timer = 0;
     ret->mirrors = NULL;
     ret->AP.idx = 0;
+    ret->AP.id = -1;
     
     memset(ret->AP.child, 0, sizeof(struct node *) * MAX_NODE);
     memset(ret->AP.blockers, 0, sizeof(struct node *) * MAX_NODE);
     memset(ret->AP.parent, 0, sizeof(struct node *) * MAX_NODE);
     memset(ret->AP.distance, 0, sizeof(double) * MAX_NODE);
     memset(ret->AP.distance_group, 0, sizeof(double) * MAX_GROUP);
-    memset(ret->AP.pp, 0, sizeof(struct node *) * MAXT);
+    memset(ret->AP.pp, 0, sizeof(struct node *) * PP_SLOTS);
     memset(ret->rr, 0, sizeof(struct node *) * MAX_NODE);
     
     ret->people = (struct node *) malloc(sizeof(struct node) * 100);
@@ -269,6 +439,7 @@ struct graph *generate_graph_unif(int width, int length, int ap_x, int ap_y, int
             if (num >= ret->population) {
                 for (int i = 0; i < ret->population; i++) {
                     ret->rr[i] = &ret->people[i];
+                    ret->people[i].id = i;
                 }
                 return ret;
             }
@@ -277,89 +448,76 @@ struct graph *generate_graph_unif(int width, int length, int ap_x, int ap_y, int
     
     for (int i = 0; i < ret->population; i++) {
         ret->rr[i] = &ret->people[i];
+        ret->people[i].id = i;
     }
     
     return ret;
 }
 
-struct graph *generate_graph_group(int width, int length, int ap_x, int ap_y, double ap_height, int population, int group_size) {
-    if (ap_x >= width || ap_y >= length) {
-        fprintf(stderr, "AP location is outside cooridnate\n");
-        return NULL;
-    }
-    
-    struct graph *ret = (struct graph *) malloc(sizeof(struct graph));
-    memset(ret->coordinate, 0, sizeof(struct node *) * LENGTH * WIDTH);
-    
-    ret->population = population;
-    ret->coordinate[ap_x][ap_y] = &(ret->AP);
-    ret->num_mirrors = 0;
-    
-    ret->AP.person = 0;
-    ret->AP.x = ap_x;
-    ret->AP.y = ap_y;
-    ret->AP.height = ap_height;
-    ret->AP.blocked = 0;
-    ret->AP.num_child = 0;
-    ret->AP.num_parent = 0;
-    ret->AP.num_blockers = 0;
-    ret->AP.num_parent = 0;
-    ret->AP.traversed = 0;
-    ret->AP.stability = 0;
-    ret->AP.checked = 0;
-    ret->AP.x_dest = ap_x;
-    ret->AP.y_dest = ap_y;
-    ret->AP.timer = 0;
-    ret->mirrors = NULL;
-    ret->AP.idx = 0;
-    ret->AP.marked = 0;
-    ret->AP.reachability = 0;
-    ret->AP.capacity = 0;
-    ret->AP.delay = 0;
-    
-    memset(ret->AP.child, 0, sizeof(struct node *) * MAX_NODE);
-    memset(ret->AP.blockers, 0, sizeof(struct node *) * MAX_NODE);
-    memset(ret->AP.parent, 0, sizeof(struct node *) * MAX_NODE);
-    memset(ret->AP.distance, 0, sizeof(double) * MAX_NODE);
-    memset(ret->AP.distance_group, 0, sizeof(double) * MAX_GROUP);
-    memset(ret->AP.pp, 0, sizeof(struct node *) * MAXT);
-    memset(ret->rr, 0 , sizeof(struct node *) * MAX_NODE);
+void init_ap(struct graph *graph, int ap_x, int ap_y, double ap_height) {
+    graph->coordinate[ap_x][ap_y] = &(graph->AP);
+    graph->epoch_checked = 0;
+    graph->epoch_marked = 0;
+    graph->epoch_traversed = 0;
     
-    ret->people = (struct node *) malloc(sizeof(struct node) * population);
+    graph->AP.person = 0;
+    graph->AP.x = ap_x;
+    graph->AP.y = ap_y;
+    graph->AP.height = ap_height;
+    graph->AP.blocked = 0;
+    graph->AP.num_child = 0;
+    clear_parents(&graph->AP);
+    graph->AP.num_blockers = 0;
+    clear_parents(&graph->AP);
+    graph->AP.traversed = 0;
+    graph->AP.stability = 0;
+    graph->AP.checked = 0;
+    graph->AP.x_dest = ap_x;
+    graph->AP.y_dest = ap_y;
+    graph->AP.timer = 0;
+    graph->AP.idx = 0;
+    graph->AP.id = -1;
+    graph->AP.marked = 0;
+    graph->AP.reachability = 0;
+    graph->AP.capacity = 0;
+    graph->AP.delay = 0;
+}
+
+void place_groups(int width, int length, struct graph *graph, int group_size) {
     int num = 0;
     int i = 0;
-    int l = ret->population / group_size;
+    int l = graph->population / group_size;
     for (; i < l; i++) {
         while (1) {
             if (width <= 5  || length <= 5) {
                 int x = (rand() % (length - 2)) + 2;
                 int y = (rand() % (width - SPACE - 2)) + 2;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, group_size, num, 3);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, group_size, num, 3);
                     num += group_size;
                     break;
                 }
             } else if (width <= 10 || length <= 10) {
                 int x = (rand() % (length - 4)) + 2;
                 int y = (rand() % (width - SPACE - 4)) + 2;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, group_size, num, 4);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, group_size, num, 4);
                     num += group_size;
                     break;
                 }
             } else if (width <= 20 || length <= 20) {
                 int x = (rand() % (length - 8)) + 4;
                 int y = (rand() % (width - SPACE - 8)) + 4;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, group_size, num, 5);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, group_size, num, 5);
                     num += group_size;
                     break;
                 }
             } else {
                 int x = (rand() % (length - 10)) + 5;
                 int y = (rand() % (width - SPACE - 10)) + 5;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, group_size, num, 6);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, group_size, num, 6);
                     num += group_size;
                     break;
                 }
@@ -367,47 +525,206 @@ struct graph *generate_graph_group(int width, int length, int ap_x, int ap_y, do
         }
     }
     
-    if (i * group_size < ret->population) {
+    if (i * group_size < graph->population) {
         while (1) {
             if (width <= 5  || length <= 5) {
                 int x = (rand() % (length - 2)) + 2;
                 int y = (rand() % (width - SPACE - 2)) + 2;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, ret->population-i*group_size, num, 3);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, graph->population-i*group_size, num, 3);
                     break;
                 }
             } else if (width <= 10 || length <= 10) {
                 int x = (rand() % (length - 4)) + 2;
                 int y = (rand() % (width - SPACE - 4)) + 2;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, ret->population-i*group_size, num, 4);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, graph->population-i*group_size, num, 4);
                     break;
                 }
             } else if (width <= 20 || length <= 20) {
                 int x = (rand() % (length - 8)) + 4;
                 int y = (rand() % (width - SPACE - 8)) + 4;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, ret->population-i*group_size, num, 5);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, graph->population-i*group_size, num, 5);
                     break;
                 }
             } else {
                 int x = (rand() % (length - 10)) + 5;
                 int y = (rand() % (width - SPACE - 10)) + 5;
-                if (ret->coordinate[x][y + SPACE] == NULL) {
-                    init_node_group(width, length, ret->coordinate, ret->people, x, y + SPACE, ret->population-i*group_size, num, 6);
+                if (graph->coordinate[x][y + SPACE] == NULL) {
+                    init_node_group(width, length, graph->coordinate, graph->people, x, y + SPACE, graph->population-i*group_size, num, 6);
                     break;
                 }
             }
         }
     }
     
-    for (int i = 0; i < ret->population; i++) {
-        ret->rr[i] = &ret->people[i];
+    for (int i = 0; i < graph->population; i++) {
+        graph->rr[i] = &graph->people[i];
+        graph->people[i].id = i;
+    }
+}
+
+struct graph *generate_graph_group(int width, int length, int ap_x, int ap_y, double ap_height, int population, int group_size) {
+    if (ap_x >= width || ap_y >= length) {
+        fprintf(stderr, "AP location is outside cooridnate\n");
+        return NULL;
     }
+    
+    struct graph *ret = (struct graph *) malloc(sizeof(struct graph));
+    memset(ret->coordinate, 0, sizeof(struct node *) * LENGTH * WIDTH);
+    
+    ret->population = population;
+    ret->num_mirrors = 0;
+    ret->mirrors = NULL;
+    init_ap(ret, ap_x, ap_y, ap_height);
+    
+    memset(ret->AP.child, 0, sizeof(struct node *) * MAX_NODE);
+    memset(ret->AP.blockers, 0, sizeof(struct node *) * MAX_NODE);
+    memset(ret->AP.parent, 0, sizeof(struct node *) * MAX_NODE);
+    memset(ret->AP.distance, 0, sizeof(double) * MAX_NODE);
+    memset(ret->AP.distance_group, 0, sizeof(double) * MAX_GROUP);
+    memset(ret->AP.pp, 0, sizeof(struct node *) * PP_SLOTS);
+    memset(ret->rr, 0 , sizeof(struct node *) * MAX_NODE);
+    
+    ret->people = (struct node *) malloc(sizeof(struct node) * population);
+    place_groups(width, length, ret, group_size);
  
     return ret;
 }
 
+//Allocate a graph once so it can be reused by regenerate_graph_group for every trial
+struct graph *alloc_graph(int population) {
+    struct graph *ret = (struct graph *) malloc(sizeof(struct graph));
+    memset(ret, 0, sizeof(struct graph));
+    ret->population = population;
+    ret->people = (struct node *) malloc(sizeof(struct node) * population);
+    memset(ret->people, 0, sizeof(struct node) * population);
+    return ret;
+}
+
+//Remove people and AP from the grid, only touching the cells they occupy
+void clear_graph(struct graph *graph) {
+    for (int i = 0; i < graph->population; i++) {
+        int x = (int) (graph->people[i].x + 0.5);
+        int y = (int) (graph->people[i].y + 0.5);
+        if (graph->coordinate[x][y] == &graph->people[i]) {
+            graph->coordinate[x][y] = NULL;
+        }
+    }
+    
+    for (int k = 0; k <= graph->num_mirrors; k++) {
+        struct node *ap = get_ap(graph, k);
+        int x = (int) (ap->x + 0.5);
+        int y = (int) (ap->y + 0.5);
+        if (graph->coordinate[x][y] == ap) {
+            graph->coordinate[x][y] = NULL;
+        }
+    }
+}
+
+//AP k of the hall, 0 is graph->AP
+struct node *get_ap(struct graph *graph, int k) {
+    return k == 0 ? &graph->AP : &graph->mirrors[k - 1];
+}
+
+//Whether one of the hall's APs sits at cell (x, y)
+int ap_cell(struct graph *graph, double x, double y) {
+    for (int k = 0; k <= graph->num_mirrors; k++) {
+        struct node *ap = get_ap(graph, k);
+        if (x == ap->x && y == ap->y) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//Give graph num_ap APs in total, kept across regenerate_graph_group; returns -1 if too many
+int alloc_mirrors(struct graph *graph, int num_ap) {
+    if (num_ap < 1 || num_ap > MAX_AP) {
+        fprintf(stderr, "Number of APs must be between 1 and %d\n", MAX_AP);
+        return -1;
+    }
+    if (graph->num_mirrors != 0) {
+        free(graph->mirrors);
+        graph->mirrors = NULL;
+    }
+    graph->num_mirrors = num_ap - 1;
+    if (graph->num_mirrors != 0) {
+        graph->mirrors = (struct node *) malloc(sizeof(struct node) * graph->num_mirrors);
+        memset(graph->mirrors, 0, sizeof(struct node) * graph->num_mirrors);
+        for (int k = 1; k < num_ap; k++) {
+            graph->mirrors[k - 1].id = -1 - k;
+        }
+    }
+    return 0;
+}
+
+//Spread the mirrors evenly along the walls, starting from the wall point nearest AP, at
+//AP's height. A cell taken by someone else pushes the mirror to the next free wall cell.
+void place_mirrors(int width, int length, struct graph *graph) {
+    int num_ap = graph->num_mirrors + 1;
+    int perimeter = 2 * (width - 1) + 2 * (length - 1);
+    int x = (int) (graph->AP.x + 0.5), y = (int) (graph->AP.y + 0.5);
+    int wall[4] = {y, width - 1 - x, length - 1 - y, x}; //bottom, right, top, left
+    int side = 0;
+    for (int s = 1; s < 4; s++) {
+        if (wall[s] < wall[side]) {
+            side = s;
+        }
+    }
+    int start = side == 0 ? x :
+                side == 1 ? (width - 1) + y :
+                side == 2 ? (width - 1) + (length - 1) + (width - 1 - x) :
+                2 * (width - 1) + (length - 1) + (length - 1 - y);
+    for (int k = 1; k < num_ap; k++) {
+        struct node *ap = &graph->mirrors[k - 1];
+        for (int p = start + k * perimeter / num_ap; ; p++) {
+            int q = p % perimeter, cx, cy;
+            if (q < width - 1) {
+                cx = q;
+                cy = 0;
+            } else if (q < (width - 1) + (length - 1)) {
+                cx = width - 1;
+                cy = q - (width - 1);
+            } else if (q < 2 * (width - 1) + (length - 1)) {
+                cx = (width - 1) - (q - (width - 1) - (length - 1));
+                cy = length - 1;
+            } else {
+                cx = 0;
+                cy = (length - 1) - (q - 2 * (width - 1) - (length - 1));
+            }
+            if (graph->coordinate[cx][cy] == NULL) {
+                graph->coordinate[cx][cy] = ap;
+                ap->x = cx;
+                ap->y = cy;
+                ap->x_dest = cx;
+                ap->y_dest = cy;
+                break;
+            }
+        }
+        ap->height = graph->AP.height;
+        ap->blocked = 0;
+        ap->num_child = 0;
+        ap->num_blockers = 0;
+    }
+}
+
+//Same as generate_graph_group but places the new trial into an existing graph from alloc_graph
+struct graph *regenerate_graph_group(struct graph *graph, int width, int length, int ap_x, int ap_y, double ap_height, int group_size) {
+    if (ap_x >= width || ap_y >= length) {
+        fprintf(stderr, "AP location is outside cooridnate\n");
+        return NULL;
+    }
+    
+    clear_graph(graph);
+    init_ap(graph, ap_x, ap_y, ap_height);
+    place_mirrors(width, length, graph);
+    place_groups(width, length, graph, group_size);
+    
+    return graph;
+}
+
 void fill_group(struct graph *graph, int group_size) {
     if (group_size > 1) {
         int i = 0;
@@ -518,6 +835,9 @@ struct graph *generate_graph_poisson(int width, int length, int ap_x, int ap_y,
     ret->population = num;
     ret->coordinate[ap_x][ap_y] = &(ret->AP);
     ret->num_mirrors = 0;
+    ret->epoch_checked = 0;
+    ret->epoch_marked = 0;
+    ret->epoch_traversed = 0;
     
     ret->AP.person = 0;
     ret->AP.x = ap_x;
@@ -525,9 +845,9 @@ struct graph *generate_graph_poisson(int width, int length, int ap_x, int ap_y,
     ret->AP.height = ap_height;
     ret->AP.blocked = 0;
     ret->AP.num_child = 0;
-    ret->AP.num_parent = 0;
+    clear_parents(&ret->AP);
     ret->AP.num_blockers = 0;
-    ret->AP.num_parent = 0;
+    clear_parents(&ret->AP);
     ret->AP.traversed = 0;
     ret->AP.stability = 0;
     ret->AP.checked = 0;
@@ -535,6 +855,7 @@ struct graph *generate_graph_poisson(int width, int length, int ap_x, int ap_y,
     ret->AP.y_dest = ap_y;
     ret->AP.timer = 0;
     ret->AP.idx = 0;
+    ret->AP.id = -1;
     ret->AP.marked = 0;
     ret->mirrors = NULL;
     
@@ -543,7 +864,7 @@ struct graph *generate_graph_poisson(int width, int length, int ap_x, int ap_y,
     memset(ret->AP.parent, 0, sizeof(struct node *) * MAX_NODE);
     memset(ret->AP.distance, 0, sizeof(double) * MAX_NODE);
     memset(ret->AP.distance_group, 0, sizeof(double) * MAX_GROUP);
-    memset(ret->AP.pp, 0, sizeof(struct node *) * MAXT);
+    memset(ret->AP.pp, 0, sizeof(struct node *) * PP_SLOTS);
     memset(ret->rr, 0, sizeof(struct node *) * MAX_NODE);
     
     ret->people = (struct node *) malloc(sizeof(struct node) * num);
@@ -568,6 +889,7 @@ struct graph *generate_graph_poisson(int width, int length, int ap_x, int ap_y,
     
     for (int i = 0; i < ret->population; i++) {
         ret->rr[i] = &ret->people[i];
+        ret->people[i].id = i;
     }
     
     return ret;
@@ -647,6 +969,78 @@ void destroy_resources(struct graph *graph) {
     free(graph);
 }
 
+//Map a node pointer of src onto the node at the same position in dst
+struct node *relocate_node(struct node *node, struct graph *src, struct graph *dst) {
+    if (node == &src->AP) {
+        return &dst->AP;
+    }
+    if (node >= src->mirrors && node < src->mirrors + src->num_mirrors) {
+        return dst->mirrors + (node - src->mirrors);
+    }
+    if (node >= src->people && node < src->people + src->population) {
+        return dst->people + (node - src->people);
+    }
+    return node;
+}
+
+void relocate_links(struct node *node, struct graph *src, struct graph *dst) {
+    for (int i = 0; i < node->num_child; i++) {
+        node->child[i] = relocate_node(node->child[i], src, dst);
+    }
+    for (int i = 0; i < node->num_blockers; i++) {
+        node->blockers[i] = relocate_node(node->blockers[i], src, dst);
+    }
+    for (int i = 0; i < node->num_parent; i++) {
+        node->parent[i] = relocate_node(node->parent[i], src, dst);
+    }
+    for (int i = 0; i < PP_SLOTS; i++) {
+        node->pp[i] = relocate_node(node->pp[i], src, dst);
+    }
+}
+
+//Snapshot src into dst (same population) with two block copies and one pointer fixup pass
+struct graph *copy_graph(struct graph *dst, struct graph *src) {
+    if (dst->population != src->population) {
+        fprintf(stderr, "Cannot copy graph with different population\n");
+        return NULL;
+    }
+    if (dst->num_mirrors != src->num_mirrors) {
+        fprintf(stderr, "Cannot copy graph with different number of APs\n");
+        return NULL;
+    }
+    
+    struct node *people = dst->people;
+    struct node *mirrors = dst->mirrors;
+    memcpy(dst, src, sizeof(struct graph));
+    dst->people = people;
+    dst->mirrors = mirrors;
+    memcpy(dst->people, src->people, sizeof(struct node) * src->population);
+    if (src->num_mirrors != 0) {
+        memcpy(dst->mirrors, src->mirrors, sizeof(struct node) * src->num_mirrors);
+    }
+    
+    for (int x = 0; x < WIDTH; x++) {
+        for (int y = 0; y < LENGTH; y++) {
+            dst->coordinate[x][y] = relocate_node(dst->coordinate[x][y], src, dst);
+        }
+    }
+    for (int i = 0; i < MAX_NODE; i++) {
+        dst->rr[i] = relocate_node(dst->rr[i], src, dst);
+    }
+    relocate_links(&dst->AP, src, dst);
+    for (int i = 0; i < dst->population; i++) {
+        relocate_links(&dst->people[i], src, dst);
+    }
+    
+    return dst;
+}
+
+struct graph *clone_graph(struct graph *graph) {
+    struct graph *ret = alloc_graph(graph->population);
+    alloc_mirrors(ret, graph->num_mirrors + 1);
+    return copy_graph(ret, graph);
+}
+
 void sort_pointer(struct graph *graph, struct node *node[MAX_NODE]) {
     for (int x = 0; x < graph->population; x++) {
         node[x] = &graph->people[x];
@@ -709,7 +1103,7 @@ int check_blockage_node(struct node *node, struct node *target, struct node *coo
             if (target->y > node->y) {
                 for (int y = temp_ny; y <= temp_tx; y++) {
                     //fprintf(stderr, "x: %d, y: %d\n", x, y);
-                    if (coordinate[x][y] != NULL) {
+                    if (coordinate[x][y] != NULL && coordinate[x][y]->id >= -1) { //mirrors are not obstacles
                         if ((x == temp_tx && y == temp_ty) ||
                             (x == temp_nx && y == temp_ny)) {
                             continue;
@@ -735,7 +1129,7 @@ int check_blockage_node(struct node *node, struct node *target, struct node *coo
             } else {
                 for (int y = temp_ty; y <= temp_ny; y++) {
                     //fprintf(stderr, "x: %d, y: %d\n", x, y);
-                    if (coordinate[x][y] != NULL) {
+                    if (coordinate[x][y] != NULL && coordinate[x][y]->id >= -1) { //mirrors are not obstacles
                         if ((x == temp_tx && y == temp_ty) ||
                             (x == temp_nx && y == temp_ny)) {
                             continue;
@@ -765,7 +1159,7 @@ int check_blockage_node(struct node *node, struct node *target, struct node *coo
             if (target->y > node->y) {
                 for (int y = temp_ny; y <= temp_ty; y++) {
                     //fprintf(stderr, "x: %d, y: %d\n", x, y);
-                    if (coordinate[x][y] != NULL) {
+                    if (coordinate[x][y] != NULL && coordinate[x][y]->id >= -1) { //mirrors are not obstacles
                         if ((x == temp_tx && y == temp_ty) ||
                             (x == temp_nx && y == temp_ny)) {
                             continue;
@@ -791,7 +1185,7 @@ int check_blockage_node(struct node *node, struct node *target, struct node *coo
             } else {
                 for (int y = temp_ty; y <= temp_ny; y++) {
                     //fprintf(stderr, "x: %d, y: %d\n", x, y);
-                    if (coordinate[x][y] != NULL) {
+                    if (coordinate[x][y] != NULL && coordinate[x][y]->id >= -1) { //mirrors are not obstacles
                         if ((x == temp_tx && y == temp_ty) ||
                             (x == temp_nx && y == temp_ny)) {
                             continue;
@@ -833,21 +1227,142 @@ int check_blockage_node(struct node *node, struct node *target, struct node *coo
     }
 }
 
+//Channel tables, filled once at startup: log10 over one octave of squared distance (the
+//exponent comes from frexp) and the Shannon rate log2(1 + 10^(snr/10)) over SNR in dB, both
+//read with linear interpolation. Links then cost no sqrt, log or pow, and shadowing is a
+//plain dB offset. Building with -DCHANNEL_CHECK compares every link with the exact formula.
+#define OCTAVE_STEPS 512
+#define SNR_MIN -40 //dB, below this the exact formula is used
+#define SNR_MAX 120 //dB, above this the rate is linear in SNR to double precision
+#define SNR_STEPS 16 //per dB
+#define SNR_SIZE ((SNR_MAX - SNR_MIN) * SNR_STEPS + 1)
+#define CHANNEL_TOL 1e-4 //relative rate error reported by CHANNEL_CHECK
+#define LOG10_2 0.30102999566398119521
+
+static double octave_log[OCTAVE_STEPS + 1]; //log10 of 0.5 .. 1
+static double snr_rate[SNR_SIZE];
+static double snr_base; //SNR in dB at squared distance 1, no shadowing
+
+__attribute__((constructor))
+void init_channel(void) {
+    snr_base = 116 - EXPO * 10 * log10(4 * PI * GHZ / LIGHT);
+    for (int i = 0; i <= OCTAVE_STEPS; i++) {
+        octave_log[i] = log10(0.5 + 0.5 * i / OCTAVE_STEPS);
+    }
+    for (int i = 0; i < SNR_SIZE; i++) {
+        snr_rate[i] = log2(1 + pow(10, (SNR_MIN + (double) i / SNR_STEPS) / 10));
+    }
+}
+
+//Rate at squared distance d2 with shadow dB added to the SNR
+double channel_rate(double d2, double shadow) {
+    if (!(d2 > 0)) { //exact formula, for its zero-distance limit
+        return BANDWIDTH * log2(1+pow(10, (116 - EXPO * 10 * log10(4 * PI * sqrt(d2) * GHZ / LIGHT) + shadow)/10));
+    }
+    int e;
+    double u = (frexp(d2, &e) - 0.5) * 2 * OCTAVE_STEPS;
+    int i = (int) u;
+    if (i >= OCTAVE_STEPS) {
+        i = OCTAVE_STEPS - 1;
+    }
+    double lg = octave_log[i] + (u - i) * (octave_log[i + 1] - octave_log[i]) + e * LOG10_2;
+    double snr = snr_base - EXPO * 5 * lg + shadow;
+    
+    double v = (snr - SNR_MIN) * SNR_STEPS;
+    if (v < 0) {
+        return BANDWIDTH * log2(1 + pow(10, snr / 10));
+    }
+    if (v >= SNR_SIZE - 1) {
+        return BANDWIDTH * snr / 10 * log2(10);
+    }
+    int j = (int) v;
+    return BANDWIDTH * (snr_rate[j] + (v - j) * (snr_rate[j + 1] - snr_rate[j]));
+}
+
+double distance2(struct node *node1, struct node *node2) {
+    double dx = node2->x - node1->x, dy = node2->y - node1->y, dh = node2->height - node1->height;
+    return dx * dx + dy * dy + dh * dh;
+}
+
 double calc_capacity(struct node *node, struct node *target) {
+#ifdef SHADOW_STREAM
+    double shadow = shadow_sample();
+#else
+    double shadow = DEV * gaussrand();
+#endif
+    double rate = channel_rate(distance2(node, target), shadow);
+#ifdef CHANNEL_CHECK
     double d = distance(node, target);
-    return BANDWIDTH * log2(1+pow(10, (116 - EXPO * 10 * log10(4 * PI * d * GHZ / LIGHT) + DEV * gaussrand())/10));
+    double exact = BANDWIDTH * log2(1+pow(10, (116 - EXPO * 10 * log10(4 * PI * d * GHZ / LIGHT) + shadow)/10));
+    if (fabs(rate - exact) > CHANNEL_TOL * exact) {
+        fprintf(stderr, "channel table off by %g at d = %f, shadow = %f dB\n", (rate - exact) / exact, d, shadow);
+    }
+#endif
+    return rate;
+}
+
+//calc_capacity without shadowing, for planning links without drawing from rand()
+double mean_capacity(struct node *node, struct node *target) {
+    return channel_rate(distance2(node, target), 0);
+}
+
+//Line of sight from every person to every AP into node->aps, and the AP each LOS node
+//associates with: the one with the best mean rate, lowest index on ties. People are
+//independent, so with -fopenmp they are split over threads; the cost grows with
+//APs x population. Shadowing is drawn afterwards, in rr order, by the callers.
+#define AP_PAR 64 //fewest person-AP pairs worth spreading over threads
+
+void find_aps(struct graph *graph) {
+    int num_ap = graph->num_mirrors + 1;
+#ifdef _OPENMP
+#pragma omp parallel for if (graph->population * num_ap >= AP_PAR)
+#endif
+    for (int x = 0; x < graph->population; x++) {
+        struct node *node = &graph->people[x];
+        double best = -1;
+        node->aps = 0;
+        node->ap = 0;
+        for (int k = 0; k < num_ap; k++) {
+            if (check_blockage_node(node, get_ap(graph, k), graph->coordinate, 0) == 1) {
+                continue;
+            }
+            node->aps |= 1u << k;
+            if (num_ap > 1) {
+                double rate = mean_capacity(node, get_ap(graph, k));
+                if (rate > best) {
+                    best = rate;
+                    node->ap = k;
+                }
+            }
+        }
+    }
 }
 
-//Construct list of blocked nodes in graph->AP.blockers and LOS nodes in graph->AP.child
+//Whether node has LOS to any AP, for nodes not classified by find_aps
+int sees_ap(struct graph *graph, struct node *node) {
+    for (int k = 0; k <= graph->num_mirrors; k++) {
+        if (check_blockage_node(node, get_ap(graph, k), graph->coordinate, 0) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//Construct list of blocked nodes in graph->AP.blockers and LOS nodes in graph->AP.child.
+//With several APs a node is LOS if it sees any of them, so every matcher relays over
+//the LOS set of all APs.
 double check_blockage(struct graph *graph) {
+    nodeset_clear(&graph->los);
+    find_aps(graph);
     for (int x = 0; x < graph->population; x++) {
-        if (check_blockage_node(graph->rr[x], &graph->AP, graph->coordinate, 0) == 1) {
+        if (graph->rr[x]->aps == 0) {
             graph->rr[x]->blocked = 1;
             graph->rr[x]->capacity = 0;
             graph->AP.blockers[graph->AP.num_blockers++] = graph->rr[x];
         } else {
-            graph->rr[x]->capacity = calc_capacity(graph->rr[x], &graph->AP);
+            graph->rr[x]->capacity = calc_capacity(graph->rr[x], get_ap(graph, graph->rr[x]->ap));
             //fprintf(stderr, "capacity: %f\n", graph->rr[x]->capacity);
+            nodeset_add(&graph->los, graph->rr[x]->id);
             graph->AP.child[graph->AP.num_child++] = graph->rr[x];
         }
     }
@@ -861,9 +1376,11 @@ double update_blockage_d2(struct graph *graph) {
     graph->AP.num_blockers = 0;
     memset(graph->AP.child, 0, sizeof(struct node *) * graph->AP.num_child);
     graph->AP.num_child = 0;
+    nodeset_clear(&graph->los);
+    find_aps(graph);
     
     for (int x = 0; x < graph->population; x++) {
-        if (check_blockage_node(graph->rr[x], &graph->AP, graph->coordinate, 0) == 1) {
+        if (graph->rr[x]->aps == 0) {
             if (graph->rr[x]->blocked == 0 &&
                 graph->rr[x]->num_parent == 0) {
                 graph->rr[x]->stability++;
@@ -872,6 +1389,7 @@ double update_blockage_d2(struct graph *graph) {
             graph->AP.blockers[graph->AP.num_blockers++] = graph->rr[x];
         } else {
             graph->rr[x]->blocked = 0;
+            nodeset_add(&graph->los, graph->rr[x]->id);
             graph->AP.child[graph->AP.num_child++] = graph->rr[x];
         }
     }
@@ -884,9 +1402,11 @@ double update_blockage(struct graph *graph) {
     graph->AP.num_blockers = 0;
     memset(graph->AP.child, 0, sizeof(struct node *) * graph->AP.num_child);
     graph->AP.num_child = 0;
+    nodeset_clear(&graph->los);
+    find_aps(graph);
     
     for (int x = 0; x < graph->population; x++) {
-        if (check_blockage_node(graph->rr[x], &graph->AP, graph->coordinate, 0) == 1) {
+        if (graph->rr[x]->aps == 0) {
             graph->rr[x]->blocked = 1;
             graph->rr[x]->capacity = 0;
             graph->rr[x]->delay = 0;
@@ -897,8 +1417,9 @@ double update_blockage(struct graph *graph) {
                 fprintf(stderr, "graph->rr[x]->num_child: %d\n", graph->rr[x]->num_child);
             }*/
             graph->rr[x]->blocked = 0;
-            graph->rr[x]->capacity = calc_capacity(graph->rr[x], &graph->AP);
+            graph->rr[x]->capacity = calc_capacity(graph->rr[x], get_ap(graph, graph->rr[x]->ap));
             //fprintf(stderr, "capacity: %f\n", graph->rr[x]->capacity);
+            nodeset_add(&graph->los, graph->rr[x]->id);
             graph->AP.child[graph->AP.num_child++] = graph->rr[x];
         }
     }
@@ -911,7 +1432,7 @@ void find_parents(struct graph *graph) {
     for (int x = 0; x < graph->AP.num_blockers; x++) {
         for (int y = 0; y < graph->AP.num_child; y++) {
             if (check_blockage_node(graph->AP.blockers[x], graph->AP.child[y], graph->coordinate, 0) == 0) {
-                graph->AP.blockers[x]->parent[graph->AP.blockers[x]->num_parent++] = graph->AP.child[y];
+                add_parent(graph->AP.blockers[x], graph->AP.child[y]);
             }
         }
     }
@@ -953,9 +1474,57 @@ void sort_parent_distance(struct graph *graph) {
     }
 }
 
-void sort_parent_capacity(struct graph *graph) {
-    struct node *temp_node = NULL;
-    double temp;
+//Stable re-sort of each blocked node's parents so links predicted to last longest over the
+//next PREDICT_STEPS timesteps come first; a link lasts while the child sees the parent and
+//the parent sees the AP. scratch is a graph of the same population used for the prediction.
+#define PREDICT_STEPS 3
+
+void sort_parent_predicted(int width, int length, struct graph *graph, struct graph *scratch) {
+    int hold[MAX_NODE][MAX_NODE];
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+            hold[x][y] = 0;
+        }
+    }
+    
+    copy_graph(scratch, graph);
+    for (int k = 0; k < PREDICT_STEPS; k++) {
+        predict_waypoint_group(width, length, scratch);
+        for (int x = 0; x < graph->AP.num_blockers; x++) {
+            struct node *child = &scratch->people[graph->AP.blockers[x]->id];
+            for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+                struct node *parent = &scratch->people[graph->AP.blockers[x]->parent[y]->id];
+                if (hold[x][y] == k &&
+                    check_blockage_node(child, parent, scratch->coordinate, 0) == 0 &&
+                    sees_ap(scratch, parent) == 1) {
+                    hold[x][y]++;
+                }
+            }
+        }
+    }
+    
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        struct node *node = graph->AP.blockers[x];
+        for (int y = 1; y < node->num_parent; y++) {
+            struct node *parent = node->parent[y];
+            double distance = node->distance[y];
+            int h = hold[x][y];
+            int z = y;
+            for (; z > 0 && hold[x][z - 1] < h; z--) {
+                node->parent[z] = node->parent[z - 1];
+                node->distance[z] = node->distance[z - 1];
+                hold[x][z] = hold[x][z - 1];
+            }
+            node->parent[z] = parent;
+            node->distance[z] = distance;
+            hold[x][z] = h;
+        }
+    }
+}
+
+void sort_parent_capacity(struct graph *graph) {
+    struct node *temp_node = NULL;
+    double temp;
     for (int x = 0; x < graph->AP.num_blockers; x++) {
         for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
             for (int z = y + 1; z < graph->AP.blockers[x]->num_parent; z++) {
@@ -988,7 +1557,7 @@ void sort_group_parent_capacity(struct graph *graph) {
         for (int y = 0; y < graph->people[i].num_blockers; y++) {
             for (int z = y + 1; z < graph->people[i].num_blockers; z++) {
                 if (graph->people[i].blockers[y]->capacity > graph->people[i].blockers[z]->capacity) {
-                    if (graph->people[i].traversed == 1) {
+                    if (FLAG(graph->people[i].traversed, graph->epoch_traversed) == 1) {
                         if (graph->people[i].idx == y) {
                             graph->people[i].idx = z;
                         } else if (graph->people[i].idx == z) {
@@ -1003,7 +1572,7 @@ void sort_group_parent_capacity(struct graph *graph) {
                     graph->people[i].blockers[z] = temp_node;
                 } else if (graph->people[i].blockers[y]->capacity == graph->people[i].blockers[z]->capacity) {
                     if (graph->people[i].distance_group[y] < graph->people[i].distance_group[z]) {
-                        if (graph->people[i].traversed == 1) {
+                        if (FLAG(graph->people[i].traversed, graph->epoch_traversed) == 1) {
                             if (graph->people[i].idx == y) {
                                 graph->people[i].idx = z;
                             } else if (graph->people[i].idx == z) {
@@ -1055,10 +1624,10 @@ void update_parents(struct graph *graph, int t) {
     for (int x = 0; x < graph->AP.num_blockers; x++) {
         memset(graph->AP.blockers[x]->parent, 0, sizeof(struct node *) * MAX_NODE);
         memset(graph->AP.blockers[x]->distance, 0, sizeof(double) * MAX_NODE);
-        graph->AP.blockers[x]->num_parent = 0;
+        clear_parents(graph->AP.blockers[x]);
         for (int y = 0; y < graph->AP.num_child; y++) {
             if (check_blockage_node(graph->AP.blockers[x], graph->AP.child[y], graph->coordinate, 0) == 0) {
-                graph->AP.blockers[x]->parent[graph->AP.blockers[x]->num_parent++] = graph->AP.child[y];
+                add_parent(graph->AP.blockers[x], graph->AP.child[y]);
             }
         }
         
@@ -1074,8 +1643,8 @@ void update_parents(struct graph *graph, int t) {
                 graph->AP.child[x]->num_child = 0;
                 graph->AP.child[x]->child[0] = NULL;
             } else {
-                graph->AP.child[x]->child[0]->pp[t] = graph->AP.child[x];
-                graph->AP.child[x]->child[0]->checked = 1;
+                graph->AP.child[x]->child[0]->pp[SLOT(t)] = graph->AP.child[x];
+                graph->AP.child[x]->child[0]->checked = STAMP(1, graph->epoch_checked);
             }
         }
     }
@@ -1091,7 +1660,7 @@ void update_parents_depth2(struct graph *graph) {
                     graph->AP.blockers[x]->child[0]->num_child = 0;
                     graph->AP.blockers[x]->child[0]->child[0]->stability++;
                     if (graph->AP.blockers[x]->child[0]->child[0]->blocked == 0) {//If node isn't blocked then it switches back to LOS
-                        graph->AP.blockers[x]->child[0]->child[0]->num_parent = 0;
+                        clear_parents(graph->AP.blockers[x]->child[0]->child[0]);
                         memset(graph->AP.blockers[x]->child[0]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
                     }
                     graph->AP.blockers[x]->child[0]->child[0] = NULL;
@@ -1100,7 +1669,7 @@ void update_parents_depth2(struct graph *graph) {
                 graph->AP.blockers[x]->num_child = 0;
                 graph->AP.blockers[x]->child[0]->stability++;
                 if (graph->AP.blockers[x]->child[0]->blocked == 0) {//Switch back to LOS
-                    graph->AP.blockers[x]->child[0]->num_parent = 0;
+                    clear_parents(graph->AP.blockers[x]->child[0]);
                     memset(graph->AP.blockers[x]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
                 }
                 graph->AP.blockers[x]->child[0] = NULL;
@@ -1109,18 +1678,18 @@ void update_parents_depth2(struct graph *graph) {
         }
         //Reset possible parent list
         memset(graph->AP.blockers[x]->parent, 0, sizeof(struct node *) * MAX_NODE);
-        graph->AP.blockers[x]->num_parent = 0;
+        clear_parents(graph->AP.blockers[x]);
         for (int y = 0; y < graph->AP.num_child; y++) {
             if (check_blockage_node(graph->AP.blockers[x], graph->AP.child[y], graph->coordinate, 0) == 0) {
-                graph->AP.blockers[x]->parent[graph->AP.blockers[x]->num_parent++] = graph->AP.child[y];
+                add_parent(graph->AP.blockers[x], graph->AP.child[y]);
             }
         }
     }
     
     //Now we want to find all nodes that should use same link. This happens only if the same links have LOS to the AP
     for (int x = 0; x < graph->population; x++) {
-        if (graph->people[x].marked == 0) {
-            graph->people[x].marked = 1;
+        if (FLAG(graph->people[x].marked, graph->epoch_marked) == 0) {
+            graph->people[x].marked = STAMP(1, graph->epoch_marked);
             if (graph->people[x].num_child == 1) {
                 if (check_blockage_node(&graph->people[x], graph->people[x].child[0], graph->coordinate, 0) == 1) {
                     if (graph->people[x].child[0]->num_child == 1) {
@@ -1129,26 +1698,26 @@ void update_parents_depth2(struct graph *graph) {
                         graph->people[x].child[0]->child[0]->checked = 0;
                         graph->people[x].child[0]->child[0]->traversed = 0;
                         if (graph->people[x].child[0]->child[0]->blocked == 0) {
-                            graph->people[x].child[0]->child[0]->num_parent = 0;
+                            clear_parents(graph->people[x].child[0]->child[0]);
                             memset(graph->people[x].child[0]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
                         }
-                        graph->people[x].child[0]->child[0]->marked = 1;
+                        graph->people[x].child[0]->child[0]->marked = STAMP(1, graph->epoch_marked);
                         graph->people[x].child[0]->child[0] = NULL;
                     }
                     graph->people[x].child[0]->stability++;
                     graph->people[x].child[0]->checked = 0;
                     graph->people[x].child[0]->traversed = 0;
                     if (graph->people[x].child[0]->blocked == 0) {
-                        graph->people[x].child[0]->num_parent = 0;
+                        clear_parents(graph->people[x].child[0]);
                         memset(graph->people[x].child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
                     }
                     graph->people[x].num_child = 0;
-                    graph->people[x].marked = 1;
+                    graph->people[x].marked = STAMP(1, graph->epoch_marked);
                     graph->people[x].child[0] = NULL;
                 } else {
-                    graph->people[x].child[0]->checked = 1;
-                    graph->people[x].child[0]->traversed = 1;
-                    graph->people[x].child[0]->marked = 1;
+                    graph->people[x].child[0]->checked = STAMP(1, graph->epoch_checked);
+                    graph->people[x].child[0]->traversed = STAMP(1, graph->epoch_traversed);
+                    graph->people[x].child[0]->marked = STAMP(1, graph->epoch_marked);
                     if (graph->people[x].child[0]->num_child == 1) {
                         if (graph->people[x].blocked == 1 || check_blockage_node(graph->people[x].child[0], graph->people[x].child[0]->child[0], graph->coordinate, 0) == 1) {
                             graph->people[x].child[0]->child[0]->stability++;
@@ -1156,15 +1725,15 @@ void update_parents_depth2(struct graph *graph) {
                             graph->people[x].child[0]->child[0]->checked = 0;
                             graph->people[x].child[0]->child[0]->traversed = 0;
                             if (graph->people[x].child[0]->child[0]->blocked == 0) {
-                                graph->people[x].child[0]->child[0]->num_parent = 0;
+                                clear_parents(graph->people[x].child[0]->child[0]);
                                 memset(graph->people[x].child[0]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
                             }
-                            graph->people[x].child[0]->child[0]->marked = 1;
+                            graph->people[x].child[0]->child[0]->marked = STAMP(1, graph->epoch_marked);
                             graph->people[x].child[0]->child[0] = NULL;
                         } else {
-                            graph->people[x].child[0]->child[0]->marked = 1;
-                            graph->people[x].child[0]->child[0]->checked = 1;
-                            graph->people[x].child[0]->child[0]->traversed = 2;
+                            graph->people[x].child[0]->child[0]->marked = STAMP(1, graph->epoch_marked);
+                            graph->people[x].child[0]->child[0]->checked = STAMP(1, graph->epoch_checked);
+                            graph->people[x].child[0]->child[0]->traversed = STAMP(2, graph->epoch_traversed);
                         }
                     }
                 }
@@ -1174,11 +1743,11 @@ void update_parents_depth2(struct graph *graph) {
     
     for (int x = 0; x < graph->AP.num_blockers; x++) {
         graph->AP.blockers[x]->marked = 0;
-        if (graph->AP.blockers[x]->checked == 0) {//quick fix
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 0) {//quick fix
             if (graph->AP.blockers[x]->num_child == 1) {
                 if (graph->AP.blockers[x]->child[0]->blocked == 0) {
                     if (graph->AP.blockers[x]->child[0]->num_parent > 0) {
-                        graph->AP.blockers[x]->child[0]->num_parent = 0;
+                        clear_parents(graph->AP.blockers[x]->child[0]);
                         memset(graph->AP.blockers[x]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
                     }
                 }
@@ -1206,8 +1775,8 @@ double update_parents_group(struct graph *graph, int t) {
                 graph->AP.child[x]->num_child = 0;
                 graph->AP.child[x]->child[0] = NULL;
             } else {
-                graph->AP.child[x]->child[0]->marked = 1;
-                graph->AP.child[x]->child[0]->pp[t] = graph->AP.child[x];
+                graph->AP.child[x]->child[0]->marked = STAMP(1, graph->epoch_marked);
+                graph->AP.child[x]->child[0]->pp[SLOT(t)] = graph->AP.child[x];
             }
         }
     }
@@ -1220,15 +1789,15 @@ double update_parents_group(struct graph *graph, int t) {
             graph->AP.blockers[x]->child[0] = NULL;
         }
         
-        if (graph->AP.blockers[x]->marked == 0) {
+        if (FLAG(graph->AP.blockers[x]->marked, graph->epoch_marked) == 0) {
             graph->AP.blockers[x]->idx = 0;
-            graph->AP.blockers[x]->num_parent = 0;
+            clear_parents(graph->AP.blockers[x]);
             memset(graph->AP.blockers[x]->parent, 0, sizeof(struct node *) * MAX_NODE);
             memset(graph->AP.blockers[x]->distance, 0, sizeof(double) * MAX_NODE);
             
             for (int y = 0; y < graph->AP.num_child; y++) { //Find parents
                 if (check_blockage_node(graph->AP.blockers[x], graph->AP.child[y], graph->coordinate, 0) == 0) {
-                    graph->AP.blockers[x]->parent[graph->AP.blockers[x]->num_parent++] = graph->AP.child[y];
+                    add_parent(graph->AP.blockers[x], graph->AP.child[y]);
                 }
             }
             
@@ -1257,8 +1826,8 @@ double update_parents_stable(struct graph *graph, int t) {
                     ret++;
                     graph->AP.child[x]->child[0]->blocked = 2;
                 }
-                graph->AP.child[x]->child[0]->checked = 1;
-                graph->AP.child[x]->child[0]->pp[t] = graph->AP.child[x];
+                graph->AP.child[x]->child[0]->checked = STAMP(1, graph->epoch_checked);
+                graph->AP.child[x]->child[0]->pp[SLOT(t)] = graph->AP.child[x];
             }
         }
     }
@@ -1269,13 +1838,13 @@ double update_parents_stable(struct graph *graph, int t) {
             graph->AP.blockers[x]->child[0] = NULL;
         }
         graph->AP.blockers[x]->idx = 0;
-        graph->AP.blockers[x]->num_parent = 0;
+        clear_parents(graph->AP.blockers[x]);
         memset(graph->AP.blockers[x]->parent, 0, sizeof(struct node *) * MAX_NODE);
         memset(graph->AP.blockers[x]->distance, 0, sizeof(double) * MAX_NODE);
         
         for (int y = 0; y < graph->AP.num_child; y++) {
             if (check_blockage_node(graph->AP.blockers[x], graph->AP.child[y], graph->coordinate, 0) == 0) {
-                graph->AP.blockers[x]->parent[graph->AP.blockers[x]->num_parent++] = graph->AP.child[y];
+                add_parent(graph->AP.blockers[x], graph->AP.child[y]);
             }
         }
     }
@@ -1297,8 +1866,8 @@ double update_parents_stable_height(struct graph *graph, int t) {
                     ret++;
                     graph->AP.blockers[x]->blocked = 2;
                 }
-                graph->AP.child[x]->child[0]->checked = 1;
-                graph->AP.child[x]->child[0]->pp[t] = graph->AP.child[x];
+                graph->AP.child[x]->child[0]->checked = STAMP(1, graph->epoch_checked);
+                graph->AP.child[x]->child[0]->pp[SLOT(t)] = graph->AP.child[x];
             }
         }
     }
@@ -1309,14 +1878,14 @@ double update_parents_stable_height(struct graph *graph, int t) {
             graph->AP.blockers[x]->child[0] = NULL;
         }
         graph->AP.blockers[x]->idx = 0;
-        graph->AP.blockers[x]->num_parent = 0;
+        clear_parents(graph->AP.blockers[x]);
         memset(graph->AP.blockers[x]->parent, 0, sizeof(struct node *) * MAX_NODE);
         memset(graph->AP.blockers[x]->distance, 0, sizeof(double) * MAX_NODE);
         
         for (int y = 0; y < graph->AP.num_child; y++) { //Find parents and distance
             if (check_blockage_node(graph->AP.blockers[x], graph->AP.child[y], graph->coordinate, 0) == 0) {
-                graph->AP.blockers[x]->parent[graph->AP.blockers[x]->num_parent] = graph->AP.child[y];
-                graph->AP.blockers[x]->distance[graph->AP.blockers[x]->num_parent++] = distance(graph->AP.blockers[x], graph->AP.child[y]);
+                graph->AP.blockers[x]->distance[graph->AP.blockers[x]->num_parent] = distance(graph->AP.blockers[x], graph->AP.child[y]);
+                add_parent(graph->AP.blockers[x], graph->AP.child[y]);
             }
         }
         
@@ -1350,40 +1919,416 @@ double update_parents_stable_height(struct graph *graph, int t) {
     return ret;
 }
 
-double greedy_matching(struct graph *graph, int t) {
-    double z = 0;
+//Deferred acceptance work list: blocked nodes still proposing, by position in
+//AP.blockers. Each round serves them in ascending order like the old rescan of
+//all blockers, but only touches the ones that are actually free. defer_accept
+//and group_accept both propose from it. Only defer_accept from scratch resumes
+//at next, so each parent link is proposed at most once there (O(edges) per call).
+//Updating and group proposers restart at parent 0 after a displacement, since
+//breaking a kept link can make an earlier parent winnable again, and pay up to a
+//full parent list per displacement.
+struct proposers {
+    struct nodeset free;
+    int pos[MAX_NODE]; //id -> position in AP.blockers, -1 if not blocked
+    int next[MAX_NODE]; //next parent to propose to
+    int rank[MAX_NODE][MAX_NODE]; //[position][parent index] -> rank at that parent, lower is preferred
+};
+
+void init_proposers(struct graph *graph, struct proposers *queue) {
+    nodeset_clear(&queue->free);
+    for (int x = 0; x < graph->population; x++) {
+        queue->pos[x] = -1;
+    }
     for (int x = 0; x < graph->AP.num_blockers; x++) {
-        int y;
-        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-            if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                graph->AP.blockers[x]->parent[y]->child[graph->AP.blockers[x]->parent[y]->num_child++] = graph->AP.blockers[x];
-                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                z++;
-                graph->AP.blockers[x]->checked = 1;
-                graph->AP.blockers[x]->blocked = 2;
-                //fprintf(stderr, "parent[y]->num_child: %d\t parent[y]->child[0]: %p\n", graph->AP.blockers[x]->parent[y]->num_child, graph->AP.blockers[x]->parent[y]->child[0]);
+        queue->pos[graph->AP.blockers[x]->id] = x;
+        queue->next[x] = 0;
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 0) {
+            nodeset_add(&queue->free, x);
+        }
+    }
+}
+
+//Next free proposer after x in this round (x = -1 starts a round), -1 once the round is done
+int next_proposer(struct graph *graph, struct proposers *queue, int x) {
+    if (x >= 0 && FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 1) {
+        nodeset_remove(&queue->free, x);
+    }
+    return nodeset_next(&queue->free, x + 1);
+}
+
+//Policies for the matching engines. Each matcher below is defer_accept or group_accept
+//with a constant policy, so the compiler specializes a copy per matcher. The maximum
+//matchers (maximal_matching, update_perfect*) need augmenting paths and stay on match.
+#define PREFER_DISTANCE 0 //parents prefer the closer node, then the taller
+#define PREFER_FAIR 1 //parents prefer the less reachable node, then as above
+#define PREFER_HEIGHT 2 //parents prefer the taller node, then the closer
+#define PREFER_FIRST 3 //parents keep the first node that takes them (greedy)
+#define EVICT_NONE 0 //no free or winnable parent: give up
+#define EVICT_FIRST 1 //else break the first breakable kept link
+#define EVICT_STABLE 2 //else break the breakable link rerouted least
+#define UPDATE_NONE 0 //match from scratch
+#define UPDATE_CHECKED 1 //keep the links from t-1 that update_parents flagged checked
+#define UPDATE_MARKED 2 //keep the links from t-1 that update_parents_group flagged marked
+
+struct policy {
+    int prefer;
+    int evict;
+    int update;
+    int blocked; //maintain blocked = 1/2 while matching
+    int reach; //count nodes left without a parent in reachability
+    int above; //propose only to taller parents, then fall back to the nearest lower one
+    int strict; //break ties by position in AP.blockers instead of keeping the holder
+    int legacy; //outdated matchers: no pp, and a broken link wipes the rerouted node's parent list
+};
+
+//Order in which parent[y] of blocked node a and parent[z] of blocked node b (same parent)
+//prefer them: -1 a first, 1 b first, 0 tie. Fair puts the less reachable node first.
+int compare_proposal(struct node *a, int y, struct node *b, int z, int prefer) {
+    if (prefer == PREFER_FAIR && a->reachability != b->reachability) {
+        return a->reachability > b->reachability ? -1 : 1;
+    }
+    if (prefer == PREFER_HEIGHT && a->height != b->height) {
+        return a->height > b->height ? -1 : 1;
+    }
+    if (a->distance[y] != b->distance[z]) {
+        return a->distance[y] < b->distance[z] ? -1 : 1;
+    }
+    if (a->height != b->height) {
+        return a->height > b->height ? -1 : 1;
+    }
+    return 0;
+}
+//Rank every blocked node among the candidates of each of its parents, once per call,
+//so accept/reject is a single compare. Equal proposals share a rank.
+void rank_proposers(struct graph *graph, struct proposers *queue, int prefer) {
+    int num[MAX_NODE] = {0};
+    int edge[MAX_NODE][MAX_NODE]; //parent id -> candidate (position, parent index) pairs
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+            int id = graph->AP.blockers[x]->parent[y]->id;
+            edge[id][num[id]++] = x * MAX_NODE + y;
+        }
+    }
+    for (int id = 0; id < graph->population; id++) {
+        for (int i = 1; i < num[id]; i++) { //insertion sort, candidate lists are short
+            int e = edge[id][i];
+            int j = i - 1;
+            while (j >= 0 && compare_proposal(graph->AP.blockers[e / MAX_NODE], e % MAX_NODE,
+                                              graph->AP.blockers[edge[id][j] / MAX_NODE], edge[id][j] % MAX_NODE, prefer) < 0) {
+                edge[id][j + 1] = edge[id][j];
+                j--;
+            }
+            edge[id][j + 1] = e;
+        }
+        int rank = 0;
+        for (int i = 0; i < num[id]; i++) { //the sort is stable and edges were added by position
+            int e = edge[id][i];
+            if (i > 0 && compare_proposal(graph->AP.blockers[edge[id][i - 1] / MAX_NODE], edge[id][i - 1] % MAX_NODE,
+                                          graph->AP.blockers[e / MAX_NODE], e % MAX_NODE, prefer) < 0) {
+                rank++;
+            }
+            queue->rank[e / MAX_NODE][e % MAX_NODE] = rank;
+        }
+    }
+}
+
+//Whether blocked node x proposing to its parent[y] displaces holder. On a tie the holder
+//stays, or with strict the lower position in AP.blockers wins as in parallel_accept.
+int outranks(struct proposers *queue, int x, int y, struct node *holder, int strict) {
+    if (holder->id < 0 || queue->pos[holder->id] < 0) {
+        return 0;
+    }
+    int h = queue->pos[holder->id];
+    if (strict && queue->rank[x][y] == queue->rank[h][holder->idx]) {
+        return x < h;
+    }
+    return queue->rank[x][y] < queue->rank[h][holder->idx];
+}
+
+//A displaced blocked node proposes again, resuming after the parent it lost
+//(only defer_accept from scratch reads next, the other modes start over)
+void requeue(struct proposers *queue, struct node *node) {
+    if (node->id >= 0 && queue->pos[node->id] >= 0) {
+        nodeset_add(&queue->free, queue->pos[node->id]);
+        queue->next[queue->pos[node->id]] = node->idx + 1;
+    }
+}
+
+
+//Whether node keeps the link it had at t-1
+static inline __attribute__((always_inline))
+int kept(struct graph *graph, struct node *node, const struct policy policy) {
+    if (policy.update == UPDATE_MARKED) {
+        return FLAG(node->marked, graph->epoch_marked);
+    }
+    return FLAG(node->checked, graph->epoch_checked);
+}
+
+//checked = matched
+//A kept link through parent may be broken: a LOS parent still relaying
+//through another node, or a parent relaying a LOS node
+static inline __attribute__((always_inline))
+int breakable(struct graph *graph, struct node *parent, const struct policy policy) {
+    return (parent->num_child == 0 && kept(graph, parent, policy) == 1) ||
+           (parent->num_child == 1 && parent->child[0]->blocked == 0);
+}
+
+//Blocked node now holds its parent[y]. defer_accept flags the links it makes traversed,
+//group_accept only its links to group members. Greedy serves each node once and never
+//compares holders, so it leaves idx and the flags as they were.
+static inline __attribute__((always_inline))
+void take_parent(struct graph *graph, struct node *node, int y, int t, const struct policy policy) {
+    if (policy.prefer != PREFER_FIRST) {
+        node->idx = y;
+        node->checked = STAMP(1, graph->epoch_checked);
+    }
+    if (policy.update == UPDATE_CHECKED && policy.prefer != PREFER_FIRST) {
+        node->traversed = STAMP(1, graph->epoch_traversed);
+    } else if (policy.update == UPDATE_MARKED) {
+        node->traversed = 0;
+    }
+    if (policy.blocked) {
+        node->blocked = 2;
+    }
+    if (policy.legacy == 0) {
+        node->pp[SLOT(t)] = node->parent[y];
+    }
+}
+
+//LOS node loses the link it kept from t-1
+static inline __attribute__((always_inline))
+void release(struct graph *graph, struct proposers *queue, struct node *node, int t, const struct policy policy) {
+    if (policy.update == UPDATE_MARKED) {
+        node->marked = 0;
+        node->traversed = 0;
+    } else {
+        node->checked = 0;
+        requeue(queue, node);
+    }
+    if (policy.legacy) {
+        memset(node->parent, 0, sizeof(struct node *) * MAX_NODE);
+        memset(node->distance, 0, sizeof(double) * MAX_NODE);
+        clear_parents(node);
+        node->idx = 0;
+        node->stability++;
+    } else {
+        node->pp[SLOT(t)] = NULL;
+    }
+}
+
+//Break the kept link through parent[y] of blocked node x in its favour
+static inline __attribute__((always_inline))
+void break_link(struct graph *graph, struct proposers *queue, int x, int y, int t, const struct policy policy) {
+    struct node *node = graph->AP.blockers[x];
+    struct node *parent = node->parent[y];
+    if (parent->num_child == 0) { //Best link, force parent to use LOS
+        struct node *relay = policy.legacy ? parent->parent[parent->idx] : parent->pp[SLOT(t)];
+        relay->num_child = 0;
+        relay->child[0] = NULL;
+        if (policy.prefer == PREFER_FIRST) {
+            update_free(graph, relay, 1);
+        }
+        release(graph, queue, parent, t, policy);
+        parent->num_child = 1;
+    } else { //Best link, force parent to route to us
+        release(graph, queue, parent->child[0], t, policy);
+        if (policy.prefer == PREFER_FIRST) {
+            update_free(graph, parent->child[0], 1);
+        }
+    }
+    parent->child[0] = node;
+    take_parent(graph, node, y, t, policy);
+}
+
+//Break a kept link for blocked node x, returns the parent index used or num_parent
+static inline __attribute__((always_inline))
+int evict(struct graph *graph, struct proposers *queue, int x, int t, const struct policy policy) {
+    struct node *node = graph->AP.blockers[x];
+    int found = 0, y = 0;
+    for (int k = 0; k < node->num_parent; k++) {
+        if ((policy.above && node->parent[k]->height <= node->height) || breakable(graph, node->parent[k], policy) == 0) {
+            continue;
+        }
+        if (found == 0) {
+            found = 1;
+            y = k;
+            if (policy.evict == EVICT_FIRST) {
                 break;
             }
+        } else if (node->parent[k]->num_child == 0 && node->parent[k]->stability < node->parent[y]->stability) {
+            y = k;
+        } else if (node->parent[k]->num_child == 1 && node->parent[k]->child[0]->stability < node->parent[y]->stability) {
+            y = k;
         }
-        
-        if (y == graph->AP.blockers[x]->num_parent) {
-            graph->AP.blockers[x]->reachability++;
+    }
+    if (found == 0) {
+        return node->num_parent;
+    }
+    break_link(graph, queue, x, y, t, policy);
+    return y;
+}
+
+//No taller parent took blocked node x: take a free parent from the highest 0.1 band of
+//parents below it, or with breaking a breakable one. Returns the parent index used or num_parent.
+static inline __attribute__((always_inline))
+int lower_parent(struct graph *graph, struct proposers *queue, int x, int t, const struct policy policy, int breaking) {
+    struct node *node = graph->AP.blockers[x];
+    double height = node->height;
+    do {
+        height -= .1;
+        for (int y = 0; y < node->num_parent; y++) {
+            struct node *parent = node->parent[y];
+            if (parent->height <= height || parent->height > height + 0.1) {
+                continue;
+            }
+            if (breaking == 0 && parent->num_child == 0 && (policy.update == UPDATE_NONE || kept(graph, parent, policy) == 0)) {
+                parent->child[0] = node;
+                parent->num_child = 1;
+                take_parent(graph, node, y, t, policy);
+                return y;
+            }
+            if (breaking && breakable(graph, parent, policy)) {
+                break_link(graph, queue, x, y, t, policy);
+                return y;
+            }
+        }
+    } while (height >= MIN_HEIGHT);
+    return node->num_parent;
+}
+
+//Blocked nodes propose down their parent lists, parents keep the one they rank best
+static inline __attribute__((always_inline))
+double defer_accept(struct graph *graph, double z, int t, const struct policy policy) {
+    double count = z;
+    struct proposers queue;
+    init_proposers(graph, &queue);
+    if (policy.prefer == PREFER_FIRST) {
+        find_free(graph, policy.update != UPDATE_NONE);
+    } else {
+        rank_proposers(graph, &queue, policy.prefer);
+    }
+    while (count < graph->AP.num_blockers) {
+        for (int x = next_proposer(graph, &queue, -1); x >= 0; x = next_proposer(graph, &queue, x)) {
+            struct node *node = graph->AP.blockers[x];
+            if (FLAG(node->checked, graph->epoch_checked) == 1) {
+                continue;
+            }
+            int y;
+            if (policy.prefer == PREFER_FIRST) { //No parent ever switches, take the first free one
+                y = first_parent_in(graph, node, &graph->free);
+                if (y >= 0) {
+                    node->parent[y]->child[0] = node;
+                    node->parent[y]->num_child = 1;
+                    nodeset_remove(&graph->free, node->parent[y]->id);
+                    count++;
+                    z++;
+                    take_parent(graph, node, y, t, policy);
+                } else {
+                    y = node->num_parent;
+                }
+            } else {
+                //Updates rescan from 0: a link broken since may have freed an earlier parent
+                for (y = policy.update ? 0 : queue.next[x]; y < node->num_parent; y++) {
+                    struct node *parent = node->parent[y];
+                    if (policy.above && parent->height <= node->height) {
+                        continue;
+                    }
+                    if (policy.update && kept(graph, parent, policy) == 1) {
+                        continue;
+                    }
+                    if (parent->num_child == 0) {
+                        parent->child[0] = node;
+                        parent->num_child = 1;
+                        count++;
+                        z++;
+                    } else if ((policy.update == UPDATE_NONE || FLAG(parent->child[0]->traversed, graph->epoch_traversed) == 1) &&
+                               outranks(&queue, x, y, parent->child[0], policy.strict)) {
+                        parent->child[0]->checked = 0;
+                        requeue(&queue, parent->child[0]);
+                        if (policy.update) {
+                            parent->child[0]->traversed = 0;
+                        }
+                        if (policy.blocked) {
+                            parent->child[0]->blocked = 1;
+                        }
+                        if (policy.legacy && policy.above && policy.update) { //as update_stable_close always did
+                            parent->child[0]->idx = 0;
+                        }
+                        if (policy.legacy == 0) {
+                            parent->child[0]->pp[SLOT(t)] = NULL;
+                        }
+                        parent->child[0] = node;
+                    } else {
+                        continue;
+                    }
+                    take_parent(graph, node, y, t, policy);
+                    break;
+                }
+            }
+            
+            if (y == node->num_parent) {
+                if (policy.above) { //Nearest free parent below
+                    y = lower_parent(graph, &queue, x, t, policy, 0);
+                }
+                if (y == node->num_parent && policy.evict != EVICT_NONE) { //Find best link among breakable parent-child pair, taller ones first
+                    y = evict(graph, &queue, x, t, policy);
+                    if (y == node->num_parent && policy.above) {
+                        y = lower_parent(graph, &queue, x, t, policy, 1);
+                    }
+                }
+                count++;
+                if (y < node->num_parent) {
+                    z++;
+                } else {
+                    if (policy.prefer != PREFER_FIRST) {
+                        node->checked = STAMP(1, graph->epoch_checked);
+                    }
+                    if (policy.reach) {
+                        node->reachability++;
+                    }
+                }
+            }
+        }
+        if (policy.prefer == PREFER_FIRST) { //Nobody is displaced, one round serves everyone
+            break;
+        }
+    }
+    
+    if (policy.update) {
+        clear_checked(graph);
+        if (policy.prefer != PREFER_FIRST) {
+            clear_traversed(graph);
+        }
+    } else {
+        for (int x = 0; x < graph->AP.num_blockers; x++) {
+            graph->AP.blockers[x]->checked = 0;
         }
     }
     
     return (double) graph->AP.num_blockers - z;
 }
 
+double greedy_matching(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FIRST, .blocked = 1, .reach = 1};
+    double ret = defer_accept(graph, 0, t, policy);
+    for (int x = 0; x < graph->AP.num_blockers; x++) { //greedy_matching_depth2 relays through these
+        if (graph->AP.blockers[x]->blocked == 2) {
+            graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
+        }
+    }
+    return ret;
+}
+
 double greedy_matching_depth2(struct graph *graph, double rem, int t) {
     double z = 0;
     for (int x = 0; x < graph->AP.num_blockers; x++) {
-        if (graph->AP.blockers[x]->checked == 0) {
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 0) {
             for (int y = 0; y < graph->AP.num_blockers; y++) {
-                if (graph->AP.blockers[y]->checked == 1 &&
+                if (FLAG(graph->AP.blockers[y]->checked, graph->epoch_checked) == 1 &&
                     graph->AP.blockers[y]->num_child == 0) {
                     if (check_blockage_node(graph->AP.blockers[x], graph->AP.blockers[y], graph->coordinate, 0) == 0) {
                         graph->AP.blockers[y]->child[graph->AP.blockers[y]->num_child++] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[y];
+                        graph->AP.blockers[x]->pp[SLOT(t)] = graph->AP.blockers[y];
                         z++;
                         break;
                     }
@@ -1399,795 +2344,339 @@ double greedy_matching_depth2(struct graph *graph, double rem, int t) {
     return rem - z;
 }
 
-//Not updated for blocked = 2 in order for visualize_reachability to work
-double group_matching(struct graph *graph, int t) {
-    double z = 0;
-    int count = 0;
-    while (count < graph->AP.num_blockers) {
-        for (int i = 0; i < graph->AP.num_blockers; i++) {
-            if (graph->AP.blockers[i]->checked == 0) {
-                int j;
-                for (j = 0; j < graph->AP.blockers[i]->num_blockers; j++) {
-                    if (graph->AP.blockers[i]->blockers[j]->blocked == 0) {
-                        if (check_blockage_node(graph->AP.blockers[i], graph->AP.blockers[i]->blockers[j], graph->coordinate, 0) == 0) {
-                            if (graph->AP.blockers[i]->blockers[j]->num_child == 0) {
-                                graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                graph->AP.blockers[i]->blockers[j]->num_child = 1;
-                                graph->AP.blockers[i]->idx = j;
-                                graph->AP.blockers[i]->checked = 1;
-                                graph->AP.blockers[i]->traversed = 1;
-                                graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                count++;
-                                z++;
-                                break;
-                            } else {
-                                if (graph->AP.blockers[i]->blockers[j]->child[0]->traversed == 1) {
-                                    if (graph->AP.blockers[i]->distance_group[j] <
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->distance_group[graph->AP.blockers[i]->blockers[j]->child[0]->idx]) {
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                        graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                        graph->AP.blockers[i]->checked = 1;
-                                        graph->AP.blockers[i]->traversed = 1;
-                                        graph->AP.blockers[i]->idx = j;
-                                        break;
-                                    } else if (graph->AP.blockers[i]->distance_group[j] ==
-                                               graph->AP.blockers[i]->blockers[j]->child[0]->distance_group[graph->AP.blockers[i]->blockers[j]->child[0]->idx]) {
-                                        if (graph->AP.blockers[i]->height > graph->AP.blockers[i]->blockers[j]->child[0]->height) {
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                            
-                                            graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                            graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                            graph->AP.blockers[i]->checked = 1;
-                                            graph->AP.blockers[i]->traversed = 1;
-                                            graph->AP.blockers[i]->idx = j;
-                                            break;
-                                        }
-                                    }
-                                } else {
-                                    graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                    graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                    graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                    graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                    graph->AP.blockers[i]->checked = 1;
-                                    graph->AP.blockers[i]->traversed = 1;
-                                    graph->AP.blockers[i]->idx = j;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (j == graph->AP.blockers[i]->num_blockers) {
-                    for (j = 0; j < graph->AP.blockers[i]->num_parent; j++) {
-                        if (graph->AP.blockers[i]->parent[j]->num_child == 0) {
-                            graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                            graph->AP.blockers[i]->parent[j]->num_child = 1;
-                            graph->AP.blockers[i]->checked = 1;
-                            graph->AP.blockers[i]->idx = j;
-                            graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                            count++;
-                            z++;
-                            break;
-                        } else if (graph->AP.blockers[i]->parent[j]->child[0]->traversed == 0) {
-                            if (graph->AP.blockers[i]->distance[j] <
-                                graph->AP.blockers[i]->parent[j]->child[0]->distance[graph->AP.blockers[i]->parent[j]->child[0]->idx]) {
-                                graph->AP.blockers[i]->parent[j]->child[0]->checked = 0;
-                                graph->AP.blockers[i]->parent[j]->child[0]->pp[t] = NULL;
-                                graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                                graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                                graph->AP.blockers[i]->checked = 1;
-                                graph->AP.blockers[i]->idx = j;
-                                break;
-                            } else if (graph->AP.blockers[i]->distance[j] ==
-                                       graph->AP.blockers[i]->parent[j]->child[0]->distance[graph->AP.blockers[i]->parent[j]->child[0]->idx]) {
-                                if (graph->AP.blockers[i]->height > graph->AP.blockers[i]->parent[j]->child[0]->height) {
-                                    graph->AP.blockers[i]->parent[j]->child[0]->checked = 0;
-                                    graph->AP.blockers[i]->parent[j]->child[0]->pp[t] = NULL;
-                                    graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                                    graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                                    graph->AP.blockers[i]->checked = 1;
-                                    graph->AP.blockers[i]->idx = j;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (j == graph->AP.blockers[i]->num_parent) {
-                    count++;
-                    graph->AP.blockers[i]->checked = 1;
-                    graph->AP.blockers[i]->reachability++;
-                }
-            }
+
+double stable_matching(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .blocked = 1, .reach = 1};
+    return defer_accept(graph, 0, t, policy);
+}
+
+double stable_matching_fair(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FAIR, .reach = 1};
+    return defer_accept(graph, 0, t, policy);
+}
+
+//outdated
+double stable_matching_height(struct graph *graph) {
+    const struct policy policy = {.prefer = PREFER_HEIGHT, .legacy = 1};
+    return defer_accept(graph, 0, 0, policy);
+}
+
+//outdated
+double stable_matching_close(struct graph *graph) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .above = 1, .legacy = 1};
+    return defer_accept(graph, 0, 0, policy);
+}
+
+//parent preference: height
+//outdated
+double stable_matching_close_height(struct graph *graph) {
+    const struct policy policy = {.prefer = PREFER_HEIGHT, .above = 1, .legacy = 1};
+    return defer_accept(graph, 0, 0, policy);
+}
+
+//Whether blocked node a at distance da displaces holder b at distance db from a group
+//member or parent. Fair puts the less reachable node first, then the closer, and breaks
+//the last tie to the shorter node from scratch but to the taller when updating.
+static inline __attribute__((always_inline))
+int group_outranks(struct node *a, double da, struct node *b, double db, const struct policy policy) {
+    if (policy.prefer == PREFER_FAIR) {
+        if (a->reachability != b->reachability) {
+            return a->reachability > b->reachability;
         }
+        if (da != db) {
+            return da < db;
+        }
+        return policy.update ? a->height > b->height : a->height < b->height;
     }
-    
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
+    if (da != db) {
+        return da < db;
     }
-    
-    return (double) graph->AP.num_blockers - z;
+    return a->height > b->height;
 }
 
-double group_matching_fair(struct graph *graph, int t) {
-    double z = 0;
-    int count = 0;
+//Blocked nodes propose to the unblocked members of their group they can see, then to their
+//parents. A member takes over from a holder not yet matched this call, a parent only from
+//one that is. When updating, marked nodes keep their links, and the policy may break one.
+//A displaced node starts over at its first member, so a call costs up to a full list
+//per displacement rather than one pass over the links.
+static inline __attribute__((always_inline))
+double group_accept(struct graph *graph, double z, int t, const struct policy policy) {
+    double count = z;
+    struct proposers queue;
+    init_proposers(graph, &queue);
     while (count < graph->AP.num_blockers) {
-        for (int i = 0; i < graph->AP.num_blockers; i++) {
-            if (graph->AP.blockers[i]->checked == 0) {
-                int j;
-                for (j = 0; j < graph->AP.blockers[i]->num_blockers; j++) {
-                    if (graph->AP.blockers[i]->blockers[j]->blocked == 0) {
-                        if (check_blockage_node(graph->AP.blockers[i], graph->AP.blockers[i]->blockers[j], graph->coordinate, 0) == 0) {
-                            if (graph->AP.blockers[i]->blockers[j]->num_child == 0) {
-                                graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                graph->AP.blockers[i]->blockers[j]->num_child = 1;
-                                graph->AP.blockers[i]->idx = j;
-                                graph->AP.blockers[i]->checked = 1;
-                                graph->AP.blockers[i]->traversed = 1;
-                                graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                count++;
-                                z++;
-                                break;
-                            } else {
-                                if (graph->AP.blockers[i]->blockers[j]->child[0]->traversed == 1) {
-                                    if (graph->AP.blockers[i]->reachability > graph->AP.blockers[i]->blockers[j]->child[0]->reachability) {
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                        graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                        graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                        graph->AP.blockers[i]->checked = 1;
-                                        graph->AP.blockers[i]->traversed = 1;
-                                        graph->AP.blockers[i]->idx = j;
-                                        break;
-                                    } else if (graph->AP.blockers[i]->reachability == graph->AP.blockers[i]->blockers[j]->child[0]->reachability) {
-                                        if (graph->AP.blockers[i]->distance_group[j] <
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->distance_group[graph->AP.blockers[i]->blockers[j]->child[0]->idx]) {
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                            graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                            
-                                            graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                            graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                            graph->AP.blockers[i]->checked = 1;
-                                            graph->AP.blockers[i]->traversed = 1;
-                                            graph->AP.blockers[i]->idx = j;
-                                            break;
-                                        } else if (graph->AP.blockers[i]->distance_group[j] ==
-                                                   graph->AP.blockers[i]->blockers[j]->child[0]->distance_group[graph->AP.blockers[i]->blockers[j]->child[0]->idx]) {
-                                            if (graph->AP.blockers[i]->height < graph->AP.blockers[i]->blockers[j]->child[0]->height) {
-                                                graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                                graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                                graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                                
-                                                graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                                graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                                graph->AP.blockers[i]->checked = 1;
-                                                graph->AP.blockers[i]->traversed = 1;
-                                                graph->AP.blockers[i]->idx = j;
-                                                break;
-                                            }
-                                        }
-                                    }
-                                } else {
-                                    graph->AP.blockers[i]->blockers[j]->child[0]->checked = 0;
-                                    graph->AP.blockers[i]->blockers[j]->child[0]->traversed = 0;
-                                    graph->AP.blockers[i]->blockers[j]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[i]->blockers[j]->child[0] = graph->AP.blockers[i];
-                                    graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->blockers[j];
-                                    graph->AP.blockers[i]->checked = 1;
-                                    graph->AP.blockers[i]->traversed = 1;
-                                    graph->AP.blockers[i]->idx = j;
-                                    break;
-                                }
-                            }
-                        }
+        for (int i = next_proposer(graph, &queue, -1); i >= 0; i = next_proposer(graph, &queue, i)) {
+            struct node *node = graph->AP.blockers[i];
+            if (FLAG(node->checked, graph->epoch_checked) == 1 || (policy.update && kept(graph, node, policy) == 1)) {
+                continue;
+            }
+            int j, done = 0;
+            for (j = 0; j < node->num_blockers; j++) {
+                struct node *member = node->blockers[j];
+                if (member->blocked != 0 || (policy.update && kept(graph, member, policy) == 1) ||
+                    check_blockage_node(node, member, graph->coordinate, 0) != 0) {
+                    continue;
+                }
+                if (member->num_child == 0) {
+                    member->child[0] = node;
+                    member->num_child = 1;
+                    count++;
+                    z++;
+                } else if ((policy.update == UPDATE_NONE || (kept(graph, member->child[0], policy) == 0 && member->child[0]->blocked > 0)) &&
+                           (FLAG(member->child[0]->traversed, graph->epoch_traversed) == 0 ||
+                            group_outranks(node, node->distance_group[j], member->child[0],
+                                           member->child[0]->distance_group[member->child[0]->idx], policy))) {
+                    member->child[0]->checked = 0;
+                    requeue(&queue, member->child[0]);
+                    member->child[0]->traversed = 0;
+                    if (policy.blocked) {
+                        member->child[0]->blocked = 1;
                     }
+                    member->child[0]->pp[SLOT(t)] = NULL;
+                    member->child[0] = node;
+                } else {
+                    continue;
                 }
-                
-                if (j == graph->AP.blockers[i]->num_blockers) {
-                    for (j = 0; j < graph->AP.blockers[i]->num_parent; j++) {
-                        if (graph->AP.blockers[i]->parent[j]->num_child == 0) {
-                            graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                            graph->AP.blockers[i]->parent[j]->num_child = 1;
-                            graph->AP.blockers[i]->checked = 1;
-                            graph->AP.blockers[i]->idx = j;
-                            graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                            count++;
-                            z++;
-                            break;
-                        } else if (graph->AP.blockers[i]->parent[j]->child[0]->traversed == 0) {
-                            if (graph->AP.blockers[i]->reachability > graph->AP.blockers[i]->parent[j]->child[0]->reachability) {
-                                graph->AP.blockers[i]->parent[j]->child[0]->checked = 0;
-                                graph->AP.blockers[i]->parent[j]->child[0]->pp[t] = NULL;
-                                graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                                graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                                graph->AP.blockers[i]->checked = 1;
-                                graph->AP.blockers[i]->idx = j;
-                                break;
-                            } else if (graph->AP.blockers[i]->reachability == graph->AP.blockers[i]->parent[j]->child[0]->reachability) {
-                                if (graph->AP.blockers[i]->distance[j] <
-                                    graph->AP.blockers[i]->parent[j]->child[0]->distance[graph->AP.blockers[i]->parent[j]->child[0]->idx]) {
-                                    graph->AP.blockers[i]->parent[j]->child[0]->checked = 0;
-                                    graph->AP.blockers[i]->parent[j]->child[0]->pp[t] = NULL;
-                                    graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                                    graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                                    graph->AP.blockers[i]->checked = 1;
-                                    graph->AP.blockers[i]->idx = j;
-                                    break;
-                                } else if (graph->AP.blockers[i]->distance[j] ==
-                                           graph->AP.blockers[i]->parent[j]->child[0]->distance[graph->AP.blockers[i]->parent[j]->child[0]->idx]) {
-                                    if (graph->AP.blockers[i]->height < graph->AP.blockers[i]->parent[j]->child[0]->height) {
-                                        graph->AP.blockers[i]->parent[j]->child[0]->checked = 0;
-                                        graph->AP.blockers[i]->parent[j]->child[0]->pp[t] = NULL;
-                                        graph->AP.blockers[i]->parent[j]->child[0] = graph->AP.blockers[i];
-                                        graph->AP.blockers[i]->pp[t] = graph->AP.blockers[i]->parent[j];
-                                        graph->AP.blockers[i]->checked = 1;
-                                        graph->AP.blockers[i]->idx = j;
-                                        break;
-                                    }
-                                }
-                            }
+                node->idx = j;
+                node->checked = STAMP(1, graph->epoch_checked);
+                node->traversed = STAMP(1, graph->epoch_traversed);
+                if (policy.blocked) {
+                    node->blocked = 2;
+                }
+                node->pp[SLOT(t)] = member;
+                done = 1;
+                break;
+            }
+            
+            if (done == 0) {
+                for (j = 0; j < node->num_parent; j++) {
+                    struct node *parent = node->parent[j];
+                    if (policy.update && kept(graph, parent, policy) == 1) {
+                        continue;
+                    }
+                    if (parent->num_child == 0) {
+                        parent->child[0] = node;
+                        parent->num_child = 1;
+                        count++;
+                        z++;
+                    } else if (FLAG(parent->child[0]->traversed, graph->epoch_traversed) == 0 &&
+                               (policy.update == UPDATE_NONE || kept(graph, parent->child[0], policy) == 0) &&
+                               group_outranks(node, node->distance[j], parent->child[0],
+                                              parent->child[0]->distance[parent->child[0]->idx], policy)) {
+                        parent->child[0]->checked = 0;
+                        requeue(&queue, parent->child[0]);
+                        parent->child[0]->traversed = 0;
+                        if (policy.blocked) {
+                            parent->child[0]->blocked = 1;
                         }
+                        parent->child[0]->pp[SLOT(t)] = NULL;
+                        parent->child[0] = node;
+                    } else {
+                        continue;
                     }
+                    take_parent(graph, node, j, t, policy);
+                    done = 1;
+                    break;
                 }
-                
-                if (j == graph->AP.blockers[i]->num_parent) {
+            }
+            
+            if (done == 0 && policy.evict != EVICT_NONE) { //Find best link among breakable parent-child pair
+                j = evict(graph, &queue, i, t, policy);
+                if (j < node->num_parent) {
                     count++;
-                    graph->AP.blockers[i]->checked = 1;
-                    graph->AP.blockers[i]->reachability++;
+                    z++;
+                    done = 1;
+                }
+            }
+            //From scratch, a member at index num_parent has always counted as no parent as well
+            if (done == 0 || (policy.update == UPDATE_NONE && j == node->num_parent)) {
+                count++;
+                node->checked = STAMP(1, graph->epoch_checked);
+                if (policy.reach) {
+                    node->reachability++;
                 }
             }
         }
     }
     
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
+    if (policy.update) {
+        clear_checked(graph);
+        clear_marked(graph);
+    } else {
+        for (int x = 0; x < graph->AP.num_blockers; x++) {
+            graph->AP.blockers[x]->checked = 0;
+        }
     }
     
     return (double) graph->AP.num_blockers - z;
 }
 
-//checked = matched
-double stable_matching(struct graph *graph, int t) {
-    double z = 0;
-    int count = 0;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->idx = y;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                        graph->AP.blockers[x]->blocked = 2;
-                        count++;
-                        z++;
-                        break;
-                    } else if (graph->AP.blockers[x]->distance[y] <
-                               graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->idx = y;
-                        break;
-                    } else if (graph->AP.blockers[x]->distance[y] ==
-                               graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                        if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            break;
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    count++;
-                    graph->AP.blockers[x]->checked = 1;
-                    graph->AP.blockers[x]->reachability++;
-                }
-            }
-        }
-    }
-    
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
+//Not updated for blocked = 2 in order for visualize_reachability to work
+double group_matching(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .reach = 1};
+    return group_accept(graph, 0, t, policy);
 }
 
-double stable_matching_fair(struct graph *graph, int t) {
-    double z = 0;
-    int count = 0;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->idx = y;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                        count++;
-                        z++;
-                        break;
-                    } else if (graph->AP.blockers[x]->reachability > graph->AP.blockers[x]->parent[y]->child[0]->reachability) {
-                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->idx = y;
-                        break;
-                    } else if (graph->AP.blockers[x]->reachability == graph->AP.blockers[x]->parent[y]->child[0]->reachability) {
-                        if (graph->AP.blockers[x]->distance[y] <
-                            graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            break;
-                        } else if (graph->AP.blockers[x]->distance[y] ==
-                                   graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                            if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->idx = y;
-                                break;
-                            }
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    count++;
-                    graph->AP.blockers[x]->checked = 1;
-                    graph->AP.blockers[x]->reachability++;
-                }
-            }
-        }
-    }
-    
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
+double group_matching_fair(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FAIR, .reach = 1};
+    return group_accept(graph, 0, t, policy);
 }
 
-//parent preference: height
-//outdated
-double stable_matching_height(struct graph *graph) {
-    double z = 0;
-    int count = 0;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->parent[y]->num_child++;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->idx = y;
-                        count++;
-                        z++;
-                        break;
-                    } else if (graph->AP.blockers[x]->height >
-                               graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->idx = y;
-                        break;
-                    } else if (graph->AP.blockers[x]->height ==
-                               graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                        if (graph->AP.blockers[x]->distance[y] <
-                            graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            break;
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    count++;
-                    graph->AP.blockers[x]->checked = 1;
-                }
-            }
+//Round-synchronous deferred acceptance: every free blocked node proposes at once, walking
+//down its list until some parent takes it. Each parent holds one packed word, (rank + 1)
+//above the proposer's position, lower is preferred; a proposer wins by compare-and-swap
+//and pushes the node it displaced onto the next round. Equal ranks go to the lower position,
+//so this is the unique proposer-optimal stable matching for those strict preferences, the
+//one serial_stable_matching finds. Proposals run on threads when built with -fopenmp and
+//there are at least DA_PAR of them.
+#define DA_PAR 16 //fewest proposers in a round worth spreading over threads
+#define DA_EMPTY 0xffffffffu //parent holds nobody
+#define DA_FIXED 0u //parent holds a node that cannot be displaced
+#define DA_WORD(rank, x) ((unsigned int) ((rank) + 1) << 16 | (unsigned int) (x))
+
+static inline __attribute__((always_inline))
+double parallel_accept(struct graph *graph, int t, const struct policy policy) {
+    int n = graph->AP.num_blockers;
+    struct proposers queue;
+    unsigned int word[MAX_NODE];
+    int lost[MAX_NODE] = {0};
+    int active[2][MAX_NODE];
+    int num[2] = {0, 0};
+    init_proposers(graph, &queue);
+    rank_proposers(graph, &queue, policy.prefer);
+    
+    for (int id = 0; id < graph->population; id++) {
+        struct node *parent = &graph->people[id];
+        if (parent->num_child == 0) {
+            word[id] = DA_EMPTY;
+        } else if (parent->child[0]->id >= 0 && queue.pos[parent->child[0]->id] >= 0) {
+            int x = queue.pos[parent->child[0]->id];
+            word[id] = DA_WORD(queue.rank[x][parent->child[0]->idx], x);
+            queue.next[x] = parent->child[0]->idx;
+        } else {
+            word[id] = DA_FIXED;
         }
     }
-    
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
+    for (int x = nodeset_first(&queue.free); x >= 0; x = nodeset_next(&queue.free, x + 1)) {
+        active[0][num[0]++] = x;
     }
     
-    return (double) graph->AP.num_blockers - z;
-}
-
-//outdated
-double stable_matching_close(struct graph *graph) {
-    double z = 0;
-    int count = 0;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->height > graph->AP.blockers[x]->height) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child++;
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            count++;
-                            z++;
-                            break;
-                        } else if (graph->AP.blockers[x]->distance[y] <
-                                   graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            break;
-                        } else if (graph->AP.blockers[x]->distance[y] ==
-                                   graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                            if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->idx = y;
-                                break;
-                            }
-                        }
-                    }
+    int cur = 0;
+    while (num[cur] > 0) {
+        int nxt = cur ^ 1;
+        num[nxt] = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (num[cur] >= DA_PAR)
+#endif
+        for (int i = 0; i < num[cur]; i++) {
+            int x = active[cur][i];
+            struct node *node = graph->AP.blockers[x];
+            for (int y = queue.next[x]; y < node->num_parent; y++) {
+                queue.next[x] = y; //published by the swap below for whoever displaces x
+                int id = node->parent[y]->id;
+                unsigned int mine = DA_WORD(queue.rank[x][y], x);
+                unsigned int held = __atomic_load_n(&word[id], __ATOMIC_RELAXED);
+                while (mine < held && !__atomic_compare_exchange_n(&word[id], &held, mine, 0,
+                                                                   __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
                 }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    double height = graph->AP.blockers[x]->height;
-                    int success = 0;
-                    do {
-                        height -= .1;
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            if (graph->AP.blockers[x]->parent[y]->height > height &&
-                                graph->AP.blockers[x]->parent[y]->height <= height + 0.1) {
-                                if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->parent[y]->num_child++;
-                                    graph->AP.blockers[x]->idx = y;
-                                    count++;
-                                    z++;
-                                    success = 1;
-                                    break;
-                                }
-                            }
-                        }
-                        if (y < graph->AP.blockers[x]->num_parent) {
-                            break;
-                        }
-                    } while (height >= MIN_HEIGHT);
-                    if (success == 0) { //Worst case
-                        /*
-                        int y;
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            for (int temp = 0;
-                                 temp < graph->AP.blockers[x]->parent[y]->child[0]->num_parent;
-                                 temp++) {
-                                if (graph->AP.blockers[x]->parent[y]->child[0]->parent[temp]->num_child == 0) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->parent[temp]->num_child++;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->parent[temp]->child[0] = graph->AP.blockers[x]->parent[y]->child[0];
-                                    graph->AP.blockers[x]->parent[y]->child[0]->idx = temp;
-                                    success = 1;
-                                    break;
-                                }
-                            }
-                            if (success == 1) {
-                                break;
-                            }
-                        }
-                        if (success == 1) {
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            z++;
-                        }*/
-                        count++;
+                if (mine < held) {
+                    if (held != DA_EMPTY) { //the displaced node resumes next round
+                        int old = held & 0xffff;
+                        queue.next[old]++;
+                        lost[old] = 1;
+                        active[nxt][__atomic_fetch_add(&num[nxt], 1, __ATOMIC_RELAXED)] = old;
                     }
-                    graph->AP.blockers[x]->checked = 1;
+                    break;
+                }
+                if (y == node->num_parent - 1) {
+                    queue.next[x] = node->num_parent;
                 }
-                
             }
         }
+        cur = nxt;
     }
     
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-        graph->AP.blockers[x]->traversed = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
-}
-
-//parent preference: height
-//outdated
-double stable_matching_close_height(struct graph *graph) {
+    //Write the final matching back, z counts parents newly taken
     double z = 0;
-    int count = 0;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->height > graph->AP.blockers[x]->height) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child++;
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            count++;
-                            z++;
-                            break;
-                        } else if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            break;
-                        } else if (graph->AP.blockers[x]->height == graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                            if (graph->AP.blockers[x]->distance[y] <
-                                graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->idx = y;
-                                break;
-                            }
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    double height = graph->AP.blockers[x]->height;
-                    int success = 0;
-                    do {
-                        height -= .1;
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            if (graph->AP.blockers[x]->parent[y]->height > height &&
-                                graph->AP.blockers[x]->parent[y]->height <= height + 0.1) {
-                                if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->parent[y]->num_child++;
-                                    graph->AP.blockers[x]->idx = y;
-                                    count++;
-                                    z++;
-                                    success = 1;
-                                    break;
-                                }
-                            }
-                        }
-                        if (y < graph->AP.blockers[x]->num_parent) {
-                            break;
-                        }
-                    } while (height >= MIN_HEIGHT);
-                    if (success == 0) { //Worst case
-                        /*int y;
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            for (int temp = 0;
-                                 temp < graph->AP.blockers[x]->parent[y]->child[0]->num_parent;
-                                 temp++) {
-                                if (graph->AP.blockers[x]->parent[y]->child[0]->parent[temp]->num_child == 0) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->parent[temp]->num_child++;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->parent[temp]->child[0] = graph->AP.blockers[x]->parent[y]->child[0];
-                                    graph->AP.blockers[x]->parent[y]->child[0]->idx = temp;
-                                    success = 1;
-                                    break;
-                                }
-                            }
-                            if (success == 1) {
-                                break;
-                            }
-                        }
-                        if (success == 1) {
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            z++;
-                        }*/
-                        count++;
-                    }
-                    graph->AP.blockers[x]->checked = 1;
-                }
-                
-            }
+    for (int id = 0; id < graph->population; id++) {
+        if (word[id] == DA_EMPTY || word[id] == DA_FIXED) {
+            continue;
         }
+        struct node *parent = &graph->people[id];
+        struct node *node = graph->AP.blockers[word[id] & 0xffff];
+        if (parent->num_child == 0) {
+            parent->num_child = 1;
+            z++;
+        }
+        parent->child[0] = node;
+        node->idx = queue.next[word[id] & 0xffff];
+        if (policy.blocked) {
+            node->blocked = 2;
+        }
+        node->pp[SLOT(t)] = parent;
     }
-    
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-        graph->AP.blockers[x]->traversed = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
-}
-
-double update_greedy(struct graph *graph, int t) {
-    double z = 0.0;
-    for (int x = 0; x < graph->AP.num_blockers; x++) { //If node blocked
-        if (graph->AP.blockers[x]->checked == 0) { //If node hasn't been marked
-            int y = 0;
-            for (; y < graph->AP.blockers[x]->num_parent; y++) {
-                if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                    graph->AP.blockers[x]->parent[y]->checked == 0) {//Get free parent
-                    graph->AP.blockers[x]->parent[y]->child[graph->AP.blockers[x]->parent[y]->num_child++] = graph->AP.blockers[x];
-                    z++;
-                    //graph->AP.blockers[x]->marked = 1;
-                    graph->AP.blockers[x]->blocked = 2;
-                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                    break;
-                }
-            }
-            
-            if (y == graph->AP.blockers[x]->num_parent) { //If no free parent found, break previous link
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                        graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) {
-                        //Modify child
-                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                        
-                        //Modify parent
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        
-                        //Modify node
-                        z++;
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                        break;
-                    } else if (graph->AP.blockers[x]->parent[y]->checked == 1) {
-                        //Modify Parent
-                        graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                        graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                        
-                        //Modify Child
-                        graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-                        graph->AP.blockers[x]->parent[y]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        
-                        //Modify Node
-                        z++;
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                        break;
-                    }
+    for (int x = 0; x < n; x++) {
+        struct node *node = graph->AP.blockers[x];
+        if (queue.next[x] >= node->num_parent) {
+            if (lost[x]) {
+                if (policy.blocked) {
+                    node->blocked = 1;
                 }
+                node->pp[SLOT(t)] = NULL;
             }
-            
-            if (y == graph->AP.blockers[x]->num_parent) {
-                graph->AP.blockers[x]->reachability++;
+            if (policy.reach) {
+                node->reachability++;
             }
-        } else { // (2) Blocked and Marked node use the same parent to maintain stability
-            z++;
-            graph->AP.blockers[x]->blocked = 2;
         }
+        node->checked = 0;
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].marked = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
+    return (double) n - z;
 }
 
-double update_greedy_stable(struct graph *graph, int t) {
-    double z = 0.0;
-    for (int x = 0; x < graph->AP.num_blockers; x++) { //If node blocked
-        if (graph->AP.blockers[x]->checked == 0) { //If node hasn't been marked
-            int y = 0;
-            for (; y < graph->AP.blockers[x]->num_parent; y++) {
-                if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                    graph->AP.blockers[x]->parent[y]->checked == 0) {//Get free parent
-                    graph->AP.blockers[x]->parent[y]->child[graph->AP.blockers[x]->parent[y]->num_child++] = graph->AP.blockers[x];
-                    z++;
-                    graph->AP.blockers[x]->blocked = 2;
-                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                    break;
-                }
-            }
-            
-            if (y == graph->AP.blockers[x]->num_parent) { //Find best link among breakable parent-child pair
-                int found = 0;
-                y = 0;
-                for (int k = 0; k < graph->AP.blockers[x]->num_parent; k++) { //possible to add threshold on distance
-                    if (graph->AP.blockers[x]->parent[k]->checked == 1) {
-                        if (found == 0) {
-                            found = 1;
-                            y = k;
-                        } else if (graph->AP.blockers[x]->parent[k]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                            y = k;
-                        }
-                    } else if (graph->AP.blockers[x]->parent[k]->num_child == 1 &&
-                               graph->AP.blockers[x]->parent[k]->child[0]->blocked == 0) {
-                        if (found == 0) {
-                            found = 1;
-                            y = k;
-                        } else if (graph->AP.blockers[x]->parent[k]->child[0]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                            y = k;
-                        }
-                    }
-                }
-                
-                if (found == 1) {
-                    if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                        graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) {
-                        //Modify child
-                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                    } else if (graph->AP.blockers[x]->parent[y]->checked == 1) {
-                        //Modify Parent
-                        graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                        graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                        
-                        //Modify Child
-                        graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-                        graph->AP.blockers[x]->parent[y]->checked = 0;
-                        graph->AP.blockers[x]->parent[y]->num_child = 1;
-                    }
-                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                    z++;
-                    graph->AP.blockers[x]->blocked = 2;
-                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                } else {
-                    graph->AP.blockers[x]->reachability++;
-                }
-            }
-        } else { // (2) Blocked and Marked node use the same parent to maintain stability
+double parallel_stable_matching(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .blocked = 1, .reach = 1, .strict = 1};
+    return parallel_accept(graph, t, policy);
+}
+
+double parallel_stable_matching_fair(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FAIR, .reach = 1, .strict = 1};
+    return parallel_accept(graph, t, policy);
+}
+
+//Serial references for the two above, same ties
+double serial_stable_matching(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .blocked = 1, .reach = 1, .strict = 1};
+    return defer_accept(graph, 0, t, policy);
+}
+
+double serial_stable_matching_fair(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FAIR, .reach = 1, .strict = 1};
+    return defer_accept(graph, 0, t, policy);
+}
+
+//Blocked nodes update_parents left checked keep their link and count as matched
+double kept_blockers(struct graph *graph) {
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 1) {
             z++;
             graph->AP.blockers[x]->blocked = 2;
         }
     }
-    
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
+    return z;
+}
+
+double update_greedy(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FIRST, .evict = EVICT_FIRST, .update = UPDATE_CHECKED, .blocked = 1, .reach = 1};
+    double ret = defer_accept(graph, kept_blockers(graph), t, policy);
+    clear_marked(graph);
+    return ret;
+}
+
+double update_greedy_stable(struct graph *graph, int t) {
+    const struct policy policy = {.prefer = PREFER_FIRST, .evict = EVICT_STABLE, .update = UPDATE_CHECKED, .blocked = 1, .reach = 1};
+    return defer_accept(graph, kept_blockers(graph), t, policy);
 }
 
 //outdated
@@ -2195,24 +2684,24 @@ double update_depth2(struct graph *graph) {
     double z = 0.0;
     int count = 0;
     for (int x = 0; x < graph->AP.num_blockers; x++) {
-        if (graph->AP.blockers[x]->checked == 1) {
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 1) {
             z++;
             count++;
-            graph->AP.blockers[x]->checked = 2;
+            graph->AP.blockers[x]->checked = STAMP(2, graph->epoch_checked);
             graph->AP.blockers[x]->blocked = 2;
         }
     }
     
     while (count < graph->AP.num_blockers) {
         for (int x = 0; x < graph->AP.num_blockers; x++) { //If node blocked
-            if (graph->AP.blockers[x]->checked == 0 && graph->AP.blockers[x]->marked == 0) { //If node hasn't been checked
+            if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 0 && FLAG(graph->AP.blockers[x]->marked, graph->epoch_marked) == 0) { //If node hasn't been checked
                 int y = 0, success = 0;
                 for (; y < graph->AP.blockers[x]->num_parent; y++) { //For all parents in LOS of AP
                     if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                        graph->AP.blockers[x]->parent[y]->traversed == 0) {//Get free parent
+                        FLAG(graph->AP.blockers[x]->parent[y]->traversed, graph->epoch_traversed) == 0) {//Get free parent
                         graph->AP.blockers[x]->parent[y]->child[graph->AP.blockers[x]->parent[y]->num_child++] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->traversed = 1;
-                        graph->AP.blockers[x]->checked = 1;
+                        graph->AP.blockers[x]->traversed = STAMP(1, graph->epoch_traversed);
+                        graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
                         z++;
                         success = 1;
                         graph->AP.blockers[x]->blocked = 2;
@@ -2223,11 +2712,11 @@ double update_depth2(struct graph *graph) {
                 if (y == graph->AP.blockers[x]->num_parent) {
                     for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {//Get Depth 1 parent
                         if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->traversed == 1) {
+                            FLAG(graph->AP.blockers[x]->parent[y]->traversed, graph->epoch_traversed) == 1) {
                             graph->AP.blockers[x]->parent[y]->child[graph->AP.blockers[x]->parent[y]->num_child++] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->traversed = 2;
+                            graph->AP.blockers[x]->traversed = STAMP(2, graph->epoch_traversed);
                             z++;
-                            graph->AP.blockers[x]->checked = 1;
+                            graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
                             success = 1;
                             graph->AP.blockers[x]->blocked = 2;
                             break;
@@ -2237,14 +2726,14 @@ double update_depth2(struct graph *graph) {
                 
                 if (y == graph->AP.blockers[x]->num_parent) { //No depth 1 LOS parent, find depth 1 blocked parent
                     for (y = 0; y < graph->AP.num_blockers; y++) {
-                        if (graph->AP.blockers[y]->checked > 0 &&
+                        if (FLAG(graph->AP.blockers[y]->checked, graph->epoch_checked) > 0 &&
                             graph->AP.blockers[y]->num_child == 0 &&
-                            graph->AP.blockers[y]->traversed < 2) {
+                            FLAG(graph->AP.blockers[y]->traversed, graph->epoch_traversed) < 2) {
                             if (check_blockage_node(graph->AP.blockers[x], graph->AP.blockers[y], graph->coordinate, 0) == 0) {
                                 graph->AP.blockers[y]->child[graph->AP.blockers[y]->num_child++] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->traversed = 2;
+                                graph->AP.blockers[x]->traversed = STAMP(2, graph->epoch_traversed);
                                 z++;
-                                graph->AP.blockers[x]->checked = 1;
+                                graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
                                 success = 1;
                                 graph->AP.blockers[x]->blocked = 2;
                                 break;
@@ -2263,16 +2752,16 @@ double update_depth2(struct graph *graph) {
                             graph->AP.blockers[x]->parent[y]->child[0]->child[0]->traversed = 0;
                             graph->AP.blockers[x]->parent[y]->child[0]->child[0]->checked = 0;
                             memset(graph->AP.blockers[x]->parent[y]->child[0]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                            graph->AP.blockers[x]->parent[y]->child[0]->child[0]->num_parent = 0;
+                            clear_parents(graph->AP.blockers[x]->parent[y]->child[0]->child[0]);
                             graph->AP.blockers[x]->parent[y]->child[0]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->traversed = 2;
+                            graph->AP.blockers[x]->traversed = STAMP(2, graph->epoch_traversed);
                             z++;
-                            graph->AP.blockers[x]->checked = 1;
+                            graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
                             success = 1;
                             graph->AP.blockers[x]->blocked = 2;
                             
                             for (int z = 0; z < graph->AP.num_blockers; z++) {
-                                if (graph->AP.blockers[z]->checked == 0 && graph->AP.blockers[z]->marked == 1) {
+                                if (FLAG(graph->AP.blockers[z]->checked, graph->epoch_checked) == 0 && FLAG(graph->AP.blockers[z]->marked, graph->epoch_marked) == 1) {
                                     graph->AP.blockers[z]->marked = 0;
                                     count--;
                                 }
@@ -2287,8 +2776,8 @@ double update_depth2(struct graph *graph) {
                         if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
                             graph->AP.blockers[x]->parent[y]->child[0]->num_child == 1 &&
                             graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0 &&
-                            graph->AP.blockers[x]->parent[y]->child[0]->child[0]->marked == 0 &&
-                            graph->AP.blockers[x]->parent[y]->child[0]->child[0]->checked == 1) {
+                            FLAG(graph->AP.blockers[x]->parent[y]->child[0]->child[0]->marked, graph->epoch_marked) == 0 &&
+                            FLAG(graph->AP.blockers[x]->parent[y]->child[0]->child[0]->checked, graph->epoch_checked) == 1) {
                             graph->AP.blockers[x]->child[0] = graph->AP.blockers[x]->parent[y]->child[0]->child[0];
                             graph->AP.blockers[x]->num_child = 1;
                             
@@ -2298,17 +2787,17 @@ double update_depth2(struct graph *graph) {
                             graph->AP.blockers[x]->parent[y]->child[0]->num_child = 0;
                             graph->AP.blockers[x]->parent[y]->child[0]->child[0] = NULL;
                             memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                            graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
+                            clear_parents(graph->AP.blockers[x]->parent[y]->child[0]);
                             
                             graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->traversed = 1;
+                            graph->AP.blockers[x]->traversed = STAMP(1, graph->epoch_traversed);
                             z++;
-                            graph->AP.blockers[x]->checked = 1;
+                            graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
                             success = 1;
                             graph->AP.blockers[x]->blocked = 2;
                             
                             for (int z = 0; z < graph->AP.num_blockers; z++) {
-                                if (graph->AP.blockers[z]->checked == 0 && graph->AP.blockers[z]->marked == 1) {
+                                if (FLAG(graph->AP.blockers[z]->checked, graph->epoch_checked) == 0 && FLAG(graph->AP.blockers[z]->marked, graph->epoch_marked) == 1) {
                                     graph->AP.blockers[z]->marked = 0;
                                     count--;
                                 }
@@ -2333,17 +2822,17 @@ double update_depth2(struct graph *graph) {
                             graph->AP.blockers[x]->parent[y]->child[0]->num_child = 0;
                             graph->AP.blockers[x]->parent[y]->child[0]->child[0] = NULL;
                             memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                            graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
+                            clear_parents(graph->AP.blockers[x]->parent[y]->child[0]);
                             
                             graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->traversed = 1;
+                            graph->AP.blockers[x]->traversed = STAMP(1, graph->epoch_traversed);
                             z++;
-                            graph->AP.blockers[x]->checked = 1;
+                            graph->AP.blockers[x]->checked = STAMP(1, graph->epoch_checked);
                             success = 1;
                             graph->AP.blockers[x]->blocked = 2;
                             
                             for (int z = 0; z < graph->AP.num_blockers; z++) {
-                                if (graph->AP.blockers[z]->checked == 0 && graph->AP.blockers[z]->marked == 1) {
+                                if (FLAG(graph->AP.blockers[z]->checked, graph->epoch_checked) == 0 && FLAG(graph->AP.blockers[z]->marked, graph->epoch_marked) == 1) {
                                     graph->AP.blockers[z]->marked = 0;
                                     count--;
                                 }
@@ -2353,2121 +2842,1635 @@ double update_depth2(struct graph *graph) {
                     }
                 }
                 
-                graph->AP.blockers[x]->marked = 1;
+                graph->AP.blockers[x]->marked = STAMP(1, graph->epoch_marked);
                 count++;
             }
         }
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].traversed = 0;
-        graph->people[x].checked = 0;
-        graph->people[x].marked = 0;
-    }
+    clear_traversed(graph);
+    clear_checked(graph);
+    clear_marked(graph);
     
     return (double) graph->AP.num_blockers - z;
 }
 
 double update_group(struct graph *graph, double z, int t) {
-    int count = ((int)(z + 0.5));
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->marked == 0 &&
-                graph->AP.blockers[x]->checked == 0) {
-                int success = 0;
-                for (int i = 0; i < graph->AP.blockers[x]->num_blockers; i++) {
-                    if (graph->AP.blockers[x]->blockers[i]->blocked == 0 &&
-                        graph->AP.blockers[x]->blockers[i]->marked == 0) {
-                        if (check_blockage_node(graph->AP.blockers[x], graph->AP.blockers[x]->blockers[i], graph->coordinate, 0) == 0) {
-                            if (graph->AP.blockers[x]->blockers[i]->num_child == 0) {
-                                graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->blockers[i]->num_child = 1;
-                                graph->AP.blockers[x]->idx = i;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->checked = 1;
-                                count++;
-                                z++;
-                                success = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                break;
-                            } else if (graph->AP.blockers[x]->blockers[i]->child[0]->marked == 0 &&
-                                       graph->AP.blockers[x]->blockers[i]->child[0]->blocked > 0) {
-                                if (graph->AP.blockers[x]->blockers[i]->child[0]->traversed == 1) {
-                                    if (graph->AP.blockers[x]->distance_group[i] <
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->distance_group[graph->AP.blockers[x]->blockers[i]->child[0]->idx]) {
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->traversed = 1;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->idx = i;
-                                        success = 1;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                        break;
-                                    } else if (graph->AP.blockers[x]->distance_group[i] ==
-                                               graph->AP.blockers[x]->blockers[i]->child[0]->distance_group[graph->AP.blockers[x]->blockers[i]->child[0]->idx]) {
-                                        if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->blockers[i]->child[0]->height) {
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                            
-                                            graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->idx = i;
-                                            success = 1;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                            break;
-                                        }
-                                    }
-                                } else {
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->idx = i;
-                                    success = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                    break;
-                                }
-                            }
-                        }
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .evict = EVICT_FIRST, .update = UPDATE_MARKED, .blocked = 1, .reach = 1};
+    return group_accept(graph, z, t, policy);
+}
+
+double update_group_stable(struct graph *graph, double z, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .evict = EVICT_STABLE, .update = UPDATE_MARKED, .blocked = 1, .reach = 1};
+    return group_accept(graph, z, t, policy);
+}
+
+double update_group_fair(struct graph *graph, double z, int t) {
+    const struct policy policy = {.prefer = PREFER_FAIR, .evict = EVICT_STABLE, .update = UPDATE_MARKED, .blocked = 1, .reach = 1};
+    return group_accept(graph, z, t, policy);
+}
+
+double update_stable(struct graph *graph, double z, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .evict = EVICT_FIRST, .update = UPDATE_CHECKED, .blocked = 1};
+    return defer_accept(graph, z, t, policy);
+}
+
+double update_stable_stable(struct graph *graph, double z, int t) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .evict = EVICT_STABLE, .update = UPDATE_CHECKED, .blocked = 1, .reach = 1};
+    return defer_accept(graph, z, t, policy);
+}
+
+double update_stable_fair(struct graph *graph, double z, int t) {
+    const struct policy policy = {.prefer = PREFER_FAIR, .evict = EVICT_STABLE, .update = UPDATE_CHECKED, .blocked = 1, .reach = 1};
+    return defer_accept(graph, z, t, policy);
+}
+
+//outdated
+double update_stable_height(struct graph *graph, double z) {
+    const struct policy policy = {.prefer = PREFER_HEIGHT, .evict = EVICT_FIRST, .update = UPDATE_CHECKED, .blocked = 1, .legacy = 1};
+    return defer_accept(graph, z, 0, policy);
+}
+
+//outdated
+double update_stable_close(struct graph *graph, double z) {
+    const struct policy policy = {.prefer = PREFER_DISTANCE, .evict = EVICT_FIRST, .update = UPDATE_CHECKED, .blocked = 1, .above = 1, .legacy = 1};
+    return defer_accept(graph, z, 0, policy);
+}
+
+//parent preference: height
+//outdated
+double update_stable_close_height(struct graph *graph, double z) {
+    const struct policy policy = {.prefer = PREFER_HEIGHT, .evict = EVICT_FIRST, .update = UPDATE_CHECKED, .blocked = 1, .above = 1, .legacy = 1};
+    return defer_accept(graph, z, 0, policy);
+}
+
+void update_graph(int width, int length, struct graph *graph) {
+    for (int x = 0; x < graph->population; x++) {
+        int dir = rand() % 9;
+        int increment = 1;
+        switch (dir) {
+            case 0:
+                while (graph->people[x].y + increment < length) {
+                    if (graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y + increment] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y + increment] = &graph->people[x];
+                        graph->people[x].y += increment;
+                        break;
                     }
+                    increment++;
                 }
-                //fprintf(stderr, "a\n");
-                if (success == 0) {
-                    for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                        if (graph->AP.blockers[x]->parent[y]->marked == 0) {
-                            if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 0;
-                                graph->AP.blockers[x]->idx = y;
-                                count++;
-                                z++;
-                                success = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                break;
-                            } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 0 &&
-                                       graph->AP.blockers[x]->parent[y]->child[0]->marked == 0) {
-                                if (graph->AP.blockers[x]->distance[y] <
-                                    graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 0;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                    success = 1;
-                                    break;
-                                } else if (graph->AP.blockers[x]->distance[y] ==
-                                           graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->idx = y;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->traversed = 0;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                        success = 1;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
+                break;
+                
+            case 1:
+                while (graph->people[x].y + increment < length &&
+                       graph->people[x].x + increment < width) {
+                    if (graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y + increment] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y + increment] = &graph->people[x];
+                        graph->people[x].y += increment;
+                        graph->people[x].x += increment;
+                        break;
                     }
+                    increment++;
                 }
-                //fprintf(stderr, "b\n");
-                if (success == 0) {
-                    for (int i = 0; i < graph->AP.blockers[x]->num_parent; i++) {
-                        if (graph->AP.blockers[x]->parent[i]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[i]->marked == 1) {
-                            graph->AP.blockers[x]->parent[i]->pp[t]->num_child = 0;
-                            graph->AP.blockers[x]->parent[i]->pp[t]->child[0] = NULL;
-                            graph->AP.blockers[x]->parent[i]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[i]->marked = 0;
-                            graph->AP.blockers[x]->parent[i]->traversed = 0;
-                            
-                            graph->AP.blockers[x]->parent[i]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[i]->num_child = 1;
-                            graph->AP.blockers[x]->idx = i;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 0;
-                            count++;
-                            z++;
-                            success = 1;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[i];
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[i]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[i]->child[0]->blocked == 0) {
-                            graph->AP.blockers[x]->parent[i]->child[0]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[i]->child[0]->marked = 0;
-                            graph->AP.blockers[x]->parent[i]->child[0]->traversed = 0;
-                            
-                            graph->AP.blockers[x]->parent[i]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->idx = i;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 0;
-                            count++;
-                            z++;
-                            success = 1;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[i];
-                            break;
-                        }
+                break;
+                
+            case 2:
+                while (graph->people[x].x + increment < width) {
+                    if (graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y] = &graph->people[x];
+                        graph->people[x].x += increment;
+                        break;
                     }
+                    increment++;
                 }
-                //fprintf(stderr, "c\n");
-                if (success == 0) {
-                    graph->AP.blockers[x]->checked = 1;
-                    count++;
-                    graph->AP.blockers[x]->reachability++;
+                break;
+                
+            case 3:
+                while (graph->people[x].y - increment >= 0 &&
+                       graph->people[x].x + increment < width) {
+                    if (graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y - increment] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y - increment] = &graph->people[x];
+                        graph->people[x].y -= increment;
+                        graph->people[x].x += increment;
+                        break;
+                    }
+                    increment++;
                 }
-            }
+                break;
+                
+            case 4:
+                while (graph->people[x].y - increment >= 0) {
+                    if (graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y - increment] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y - increment] = &graph->people[x];
+                        graph->people[x].y -= increment;
+                        break;
+                    }
+                    increment++;
+                }
+                break;
+                
+            case 5:
+                while (graph->people[x].y - increment >= 0 &&
+                       graph->people[x].x - increment >= 0) {
+                    if (graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y - increment] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y - increment] = &graph->people[x];
+                        graph->people[x].y -= increment;
+                        graph->people[x].x -= increment;
+                        break;
+                    }
+                    increment++;
+                }
+                break;
+                
+            case 6:
+                while (graph->people[x].x - increment >= 0) {
+                    if (graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y] = &graph->people[x];
+                        graph->people[x].x -= increment;
+                        break;
+                    }
+                    increment++;
+                }
+                break;
+                
+            case 7:
+                while (graph->people[x].y + increment < length &&
+                       graph->people[x].x - increment >= 0) {
+                    if (graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y + increment] == NULL) {
+                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
+                        graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y + increment] = &graph->people[x];
+                        graph->people[x].y += increment;
+                        graph->people[x].x -= increment;
+                        break;
+                    }
+                    increment++;
+                }
+                break;
+                
+            case 8:
+            default:
+                break;
         }
-        //fprintf(stderr, "count: %d, blockers: %d\n", count, graph->AP.num_blockers);
-    }
-    
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].marked = 0;
     }
-    
-    return (double) graph->AP.num_blockers - z;
 }
 
-double update_group_stable(struct graph *graph, double z, int t) {
-    int count = ((int)(z + 0.5));
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->marked == 0 &&
-                graph->AP.blockers[x]->checked == 0) {
-                int success = 0;
-                for (int i = 0; i < graph->AP.blockers[x]->num_blockers; i++) {
-                    if (graph->AP.blockers[x]->blockers[i]->blocked == 0 &&
-                        graph->AP.blockers[x]->blockers[i]->marked == 0) {
-                        if (check_blockage_node(graph->AP.blockers[x], graph->AP.blockers[x]->blockers[i], graph->coordinate, 0) == 0) {
-                            if (graph->AP.blockers[x]->blockers[i]->num_child == 0) {
-                                graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->blockers[i]->num_child = 1;
-                                graph->AP.blockers[x]->idx = i;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->checked = 1;
-                                count++;
-                                z++;
-                                success = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                break;
-                            } else if (graph->AP.blockers[x]->blockers[i]->child[0]->marked == 0 &&
-                                       graph->AP.blockers[x]->blockers[i]->child[0]->blocked > 0) {
-                                if (graph->AP.blockers[x]->blockers[i]->child[0]->traversed == 1) {
-                                    if (graph->AP.blockers[x]->distance_group[i] <
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->distance_group[graph->AP.blockers[x]->blockers[i]->child[0]->idx]) {
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->traversed = 1;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->idx = i;
-                                        success = 1;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                        break;
-                                    } else if (graph->AP.blockers[x]->distance_group[i] ==
-                                               graph->AP.blockers[x]->blockers[i]->child[0]->distance_group[graph->AP.blockers[x]->blockers[i]->child[0]->idx]) {
-                                        if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->blockers[i]->child[0]->height) {
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                            
-                                            graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->idx = i;
-                                            success = 1;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                            break;
-                                        }
-                                    }
-                                } else {
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->idx = i;
-                                    success = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                    break;
-                                }
-                            }
+void update_graph_waypoint_group(int width, int length, struct graph *graph) {
+    for (int x = 0; x < graph->population; x++) {
+        if (graph->people[x].person == 0) {
+            continue;
+        }
+        if ((graph->people[x].x != graph->people[x].x_dest) ||
+            (graph->people[x].y != graph->people[x].y_dest)) {
+            if (graph->people[x].x != graph->people[x].x_dest) {
+                double increment = 1;
+                if (graph->people[x].x_dest < graph->people[x].x) {
+                    while (graph->people[x].x - increment >= 0) {
+                        if (graph->coordinate[(int)(graph->people[x].x - increment + 0.5)][(int)(graph->people[x].y + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].x - increment + 0.5)][(int)(graph->people[x].y + 0.5)] = &graph->people[x];
+                            graph->people[x].x -= increment;
+                            break;
                         }
+                        increment++;
                     }
-                }
-                
-                if (success == 0) {
-                    for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                        if (graph->AP.blockers[x]->parent[y]->marked == 0) {
-                            if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 0;
-                                graph->AP.blockers[x]->idx = y;
-                                count++;
-                                z++;
-                                success = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                break;
-                            } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 0 &&
-                                       graph->AP.blockers[x]->parent[y]->child[0]->marked == 0) {
-                                if (graph->AP.blockers[x]->distance[y] <
-                                    graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 0;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                    success = 1;
-                                    break;
-                                } else if (graph->AP.blockers[x]->distance[y] ==
-                                           graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->idx = y;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->traversed = 0;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                        success = 1;
-                                        break;
-                                    }
-                                }
-                            }
+                    
+                    graph->people[x].timer++;
+                } else {
+                    while (graph->people[x].x + increment < width) {
+                        if (graph->coordinate[(int)(graph->people[x].x + increment + 0.5)][(int)(graph->people[x].y + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].x + increment + 0.5)][(int)(graph->people[x].y + 0.5)] = &graph->people[x];
+                            graph->people[x].x += increment;
+                            break;
                         }
+                        increment++;
                     }
+                    
+                    graph->people[x].timer++;
                 }
-                
-                if (success == 0) {
-                    int y = 0;
-                    for (int k = 0; k < graph->AP.blockers[x]->num_parent; k++) { //possible to add threshold on distance
-                        if (graph->AP.blockers[x]->parent[k]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[k]->marked == 1) {
-                            if (success == 0) {
-                                success = 1;
-                                y = k;
-                            } else if (graph->AP.blockers[x]->parent[k]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        } else if (graph->AP.blockers[x]->parent[k]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[k]->child[0]->blocked == 0) {
-                            if (success == 0) {
-                                success = 1;
-                                y = k;
-                            } else if (graph->AP.blockers[x]->parent[k]->child[0]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
+            }
+            if (graph->people[x].y != graph->people[x].y_dest) {
+                double increment = 1;
+                if (graph->people[x].y_dest < graph->people[x].y) {
+                    while (graph->people[x].y - increment >= 0) {
+                        if (graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y - increment + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y - increment + 0.5)] = &graph->people[x];
+                            graph->people[x].y -= increment;
+                            break;
                         }
+                        increment++;
                     }
                     
-                    if (success == 1) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->marked == 1) {
-                            //Modify Parent
-                            graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                            
-                            //Modify Node
-                            graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->marked = 0;
-                            graph->AP.blockers[x]->parent[y]->traversed = 0;
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) {
-                            //Modify Child
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->child[0]->marked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
+                    graph->people[x].timer++;
+                } else {
+                    while (graph->people[x].y + increment < length) {
+                        if (graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + increment + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + increment + 0.5)] = &graph->people[x];
+                            graph->people[x].y += increment;
+                            break;
+                        }
+                        increment++;
+                    }
+                    
+                    graph->people[x].timer++;
+                }
+            }
+            
+            for (int y = 0; y < graph->people[x].num_blockers; y++) {
+                int chx = 0, chy = 0;
+                if (((int) (graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5) >= 0) &&
+                    ((int) (graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5) < length)) {
+                    if (graph->people[x].x + graph->people[x].blockers[y]->x_dest != graph->people[x].blockers[y]->x) {
+                        chx = 1;
+                    }
+                }
+                
+                if (((int) (graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5) >= 0) &&
+                    ((int) (graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5) < width)) {
+                    if (graph->people[x].y + graph->people[x].blockers[y]->y_dest != graph->people[x].blockers[y]->y) {
+                        chy = 1;
+                    }
+                }
+                
+                if (chx == 1) {
+                    if (chy == 1) {
+                        if (graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] = graph->people[x].blockers[y];
+                            graph->people[x].blockers[y]->x = graph->people[x].x + graph->people[x].blockers[y]->x_dest;
+                            graph->people[x].blockers[y]->y = graph->people[x].y + graph->people[x].blockers[y]->y_dest;
                         }
-                        
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->idx = y;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->traversed = 0;
-                        count++;
-                        z++;
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
                     } else {
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->reachability++;
-                        count++;
+                        if (graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)]= graph->people[x].blockers[y];
+                            graph->people[x].blockers[y]->x = graph->people[x].x + graph->people[x].blockers[y]->x_dest;
+                        }
+                    }
+                } else {
+                    if (chy == 1) {
+                        if (graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] == NULL) {
+                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] = NULL;
+                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] = graph->people[x].blockers[y];
+                            graph->people[x].blockers[y]->y = graph->people[x].y + graph->people[x].blockers[y]->y_dest;
+                        }
                     }
                 }
             }
+            
+            if (graph->people[x].timer >= length || graph->people[x].timer >= width) {
+                graph->people[x].timer = 0;
+                do {
+                    graph->people[x].x_dest = rand() % width;
+                    graph->people[x].y_dest = rand() % length;
+                } while (ap_cell(graph, graph->people[x].x_dest, graph->people[x].y_dest));
+            }
+        } else if (graph->people[x].timer > 0) {
+            if (graph->people[x].timer > 5) {
+                graph->people[x].timer = rand() % 5;
+            }
+            graph->people[x].timer--;
+        } else {
+            do {
+                graph->people[x].x_dest = rand() % width;
+                graph->people[x].y_dest = rand() % length;
+            } while (ap_cell(graph, graph->people[x].x_dest, graph->people[x].y_dest));
+        }
+    }
+}
+
+//Put node at cell (x, y) if the cell is free, else leave it where it is
+void move_node(struct graph *graph, struct node *node, double x, double y) {
+    struct node **cell = &graph->coordinate[(int)(x + 0.5)][(int)(y + 0.5)];
+    if (*cell != NULL && *cell != node) {
+        return;
+    }
+    if (graph->coordinate[(int)(node->x + 0.5)][(int)(node->y + 0.5)] == node) {
+        graph->coordinate[(int)(node->x + 0.5)][(int)(node->y + 0.5)] = NULL;
+    }
+    *cell = node;
+    node->x = x;
+    node->y = y;
+}
+
+//One timestep of update_graph_waypoint_group as far as it is predictable, for a scratch
+//copy: leaders move a cell per axis toward (x_dest, y_dest) and stay once there, followers
+//keep their offset from the leader. Blocked cells are not stepped around and no new
+//waypoints are drawn, so rand() is untouched.
+void predict_waypoint_group(int width, int length, struct graph *graph) {
+    for (int x = 0; x < graph->population; x++) {
+        struct node *node = &graph->people[x];
+        if (node->person == 0) {
+            continue;
+        }
+        move_node(graph, node, node->x + (node->x_dest > node->x) - (node->x_dest < node->x),
+                  node->y + (node->y_dest > node->y) - (node->y_dest < node->y));
+        for (int y = 0; y < node->num_blockers; y++) {
+            double fx = node->x + node->blockers[y]->x_dest;
+            double fy = node->y + node->blockers[y]->y_dest;
+            if ((int)(fx + 0.5) >= 0 && (int)(fx + 0.5) < length &&
+                (int)(fy + 0.5) >= 0 && (int)(fy + 0.5) < width) {
+                move_node(graph, node->blockers[y], fx, fy);
+            }
+        }
+    }
+}
+
+void shift_index(struct graph *graph) {
+    struct node *temp = graph->rr[0];
+    for (int x = 0; x < graph->population - 1; x++) {
+        graph->rr[x] = graph->rr[x+1];
+    }
+    graph->rr[graph->population - 1] = temp;
+}
+
+void sort_height_index(struct graph *graph) {
+    struct node *temp = NULL;
+    for (int x = 0; x < graph->population; x++) {
+        for (int y = x + 1; y < graph->population; y++) {
+            if (graph->rr[x]->height > graph->rr[y]->height) {
+                temp = graph->rr[y];
+                graph->rr[y] = graph->rr[x];
+                graph->rr[x] = temp;
+            }
+        }
+    }
+}
+
+void sort_stability(struct graph *graph) {
+    struct node *temp = NULL;
+    for (int x = 0; x < graph->population; x++) {
+        for (int y = x + 1; y < graph->population; y++) {
+            if (graph->rr[x]->stability < graph->rr[y]->stability) {
+                temp = graph->rr[y];
+                graph->rr[y] = graph->rr[x];
+                graph->rr[x] = temp;
+            }
+        }
+    }
+}
+
+void sort_reachability(struct graph *graph) {
+    struct node *temp = NULL;
+    for (int x = 0; x < graph->population; x++) {
+        for (int y = x + 1; y < graph->population; y++) {
+            if (graph->rr[x]->reachability < graph->rr[y]->reachability) {
+                temp = graph->rr[y];
+                graph->rr[y] = graph->rr[x];
+                graph->rr[x] = temp;
+            }
+        }
+    }
+}
+
+//Parent lists are only read below num_parent, as in init_links
+void reset(struct graph *graph) {
+    for (int x = 0; x < graph->population; x++) {
+        graph->people[x].traversed = 0;
+        graph->people[x].idx = 0;
+        graph->people[x].checked = 0;
+        graph->people[x].num_child = 0;
+        graph->people[x].child[0] = NULL;
+        clear_parents(&graph->people[x]);
+#ifdef SANITIZE
+        memset(graph->people[x].parent, 0xa5, sizeof(graph->people[x].parent));
+        memset(graph->people[x].distance, 0xa5, sizeof(graph->people[x].distance));
+#endif
+    }
+}
+
+//Augmenting path search shared by match, skip_match and all_match, with an explicit stack
+//instead of one call per hop. AUGMENT_SKIP passes over kept links (checked parents or
+//children), AUGMENT_ALL may end the path by releasing a kept LOS child. Each frame holds a
+//node and the next parent to try; a push claims a parent not yet traversed in this epoch,
+//so the stack never holds more than MAX_NODE + 1 frames.
+#define AUGMENT_PLAIN 0
+#define AUGMENT_SKIP 1
+#define AUGMENT_ALL 2
+
+struct frame {
+    struct node *node;
+    int next;
+};
+
+//Move every node on the stack to the parent it is exploring, deepest first
+static inline __attribute__((always_inline))
+void relink(struct frame *stack, int top, int mode, int t) {
+    for (; top >= 0; top--) {
+        struct node *node = stack[top].node;
+        struct node *parent = node->parent[stack[top].next - 1];
+        if (mode == AUGMENT_ALL) {
+            parent->pp[SLOT(t)] = NULL;
+        }
+        parent->child[0] = node;
+        parent->num_child = 1;
+        node->pp[SLOT(t)] = parent;
+        node->blocked = 2;
+    }
+}
+
+static inline __attribute__((always_inline))
+int augment(struct graph *graph, struct node *root, int mode, int t) {
+    struct frame stack[MAX_NODE + 1];
+    int top = 0;
+    if (mode == AUGMENT_ALL && root->blocked == 0 && FLAG(root->checked, graph->epoch_checked) == 1) {
+        root->checked = 0;
+        root->pp[SLOT(t)] = NULL;
+        return 1;
+    }
+    stack[0].node = root;
+    stack[0].next = 0;
+    
+    while (top >= 0) {
+        struct node *node = stack[top].node;
+        struct node *parent = NULL;
+        while (stack[top].next < node->num_parent) {
+            struct node *candidate = node->parent[stack[top].next++];
+            if (mode == AUGMENT_SKIP &&
+                ((candidate->num_child == 1 && FLAG(candidate->child[0]->checked, graph->epoch_checked) == 1) ||
+                 FLAG(candidate->checked, graph->epoch_checked) == 1)) {
+                continue;
+            }
+            if (FLAG(candidate->traversed, graph->epoch_traversed) == 0) {
+                candidate->traversed = STAMP(1, graph->epoch_traversed);
+                parent = candidate;
+                break;
+            }
+        }
+        if (parent == NULL) { //no path through this node, back to the frame below
+            top--;
+            continue;
+        }
+        if (parent->num_child == 0) {
+            relink(stack, top, mode, t);
+            return 1;
+        }
+        
+        struct node *child = parent->child[0];
+        if (mode == AUGMENT_ALL && child->blocked == 0 && FLAG(child->checked, graph->epoch_checked) == 1) {
+            child->checked = 0;
+            child->pp[SLOT(t)] = NULL;
+            relink(stack, top, mode, t);
+            return 1;
+        }
+        top++;
+        stack[top].node = child;
+        stack[top].next = 0;
+    }
+    
+    return 0;
+}
+
+int match(struct graph *graph, struct node *node, int t) {
+    return augment(graph, node, AUGMENT_PLAIN, t);
+}
+
+//Augmenting path where each parent may hold up to b children: a full parent is taken
+//over if one of its children can move elsewhere. With b = 1 this is match().
+int b_match(struct graph *graph, struct node *node, unsigned int b, int t) {
+    for (int x = 0; x < node->num_parent; x++) {
+        struct node *parent = node->parent[x];
+        if (FLAG(parent->traversed, graph->epoch_traversed) == 0) {
+            parent->traversed = STAMP(1, graph->epoch_traversed);
+            
+            int y = parent->num_child;
+            if (parent->num_child >= b) {
+                for (y = 0; y < parent->num_child; y++) {
+                    if (b_match(graph, parent->child[y], b, t) == 1) {
+                        break;
+                    }
+                }
+            }
+            if (y < parent->num_child || parent->num_child < b) {
+                if (y == parent->num_child) {
+                    parent->num_child++;
+                }
+                parent->child[y] = node;
+                node->blocked = 2;
+                node->pp[SLOT(t)] = parent;
+                return 1;
+            }
+        }
+    }
+    
+    return 0;
+}
+
+int skip_match(struct graph *graph, struct node *node, int t) {
+    return augment(graph, node, AUGMENT_SKIP, t);
+}
+
+int all_match(struct graph *graph, struct node *node, int t) {
+    return augment(graph, node, AUGMENT_ALL, t);
+}
+
+int update_match(struct graph *graph, struct node *node, int t) {
+    for (int x = 0; x < node->num_parent; x++) {
+        if ((node->parent[x]->num_child == 1 &&
+            FLAG(node->parent[x]->child[0]->checked, graph->epoch_checked) == 1) ||
+            (FLAG(node->parent[x]->checked, graph->epoch_checked) == 1)) {
+            continue;
+        }
+        if (FLAG(node->parent[x]->traversed, graph->epoch_traversed) == 0) {
+            node->parent[x]->traversed = STAMP(1, graph->epoch_traversed);
+            
+            if (node->parent[x]->num_child == 0 || skip_match(graph, node->parent[x]->child[0], t)) {
+                node->parent[x]->child[0] = node;
+                node->parent[x]->num_child = 1;
+                node->pp[SLOT(t)] = node->parent[x];
+                node->blocked = 2;
+                return 1;
+            }
+        }
+    }
+    for (int x = 0; x < node->num_parent; x++) {
+        if (FLAG(node->parent[x]->traversed, graph->epoch_traversed) == 0) {
+            node->parent[x]->traversed = STAMP(1, graph->epoch_traversed);
+            
+            if (node->parent[x]->num_child == 0 || all_match(graph, node->parent[x]->child[0], t)) {
+                node->parent[x]->pp[SLOT(t)] = NULL;
+                node->parent[x]->child[0] = node;
+                node->parent[x]->num_child = 1;
+                node->pp[SLOT(t)] = node->parent[x];
+                node->blocked = 2;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int update_match_stable(struct graph *graph, struct node *node, int t) {
+    for (int x = 0; x < node->num_parent; x++) {
+        if ((node->parent[x]->num_child == 1 &&
+             FLAG(node->parent[x]->child[0]->checked, graph->epoch_checked) == 1) ||
+            (FLAG(node->parent[x]->checked, graph->epoch_checked) == 1)) {
+            continue;
+        }
+        if (FLAG(node->parent[x]->traversed, graph->epoch_traversed) == 0) {
+            node->parent[x]->traversed = STAMP(1, graph->epoch_traversed);
+            
+            if (node->parent[x]->num_child == 0 || skip_match(graph, node->parent[x]->child[0], t)) {
+                node->parent[x]->child[0] = node;
+                node->parent[x]->num_child = 1;
+                node->pp[SLOT(t)] = node->parent[x];
+                node->blocked = 2;
+                return 1;
+            }
+        }
+    }
+    
+    int found = 0, y = 0;
+    for (int z = 0; z < node->num_parent; z++) { //possible to add threshold on distance
+        if (FLAG(node->parent[z]->checked, graph->epoch_checked) == 1) {
+            if (found == 0) {
+                found = 1;
+                y = z;
+            } else if (node->parent[z]->stability < node->parent[y]->stability) {
+                y = z;
+            }
+        } else if (node->parent[z]->num_child == 1 &&
+                   node->parent[z]->child[0]->blocked == 0) {
+            if (found == 0) {
+                found = 1;
+                y = z;
+            } else if (node->parent[z]->child[0]->stability < node->parent[y]->stability) {
+                y = z;
+            }
         }
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].marked = 0;
+    if (found == 1) {
+        if (node->parent[y]->num_child == 1 &&
+            node->parent[y]->child[0]->blocked == 0) {
+            //Modify child
+            node->parent[y]->child[0]->checked = 0;
+            node->parent[y]->child[0]->pp[SLOT(t)] = NULL;
+        } else if (FLAG(node->parent[y]->checked, graph->epoch_checked) == 1) {
+            //Modify Parent
+            node->parent[y]->pp[SLOT(t)]->num_child = 0;
+            node->parent[y]->pp[SLOT(t)]->child[0] = NULL;
+            
+            //Modify Child
+            node->parent[y]->pp[SLOT(t)] = NULL;
+            node->parent[y]->checked = 0;
+            node->parent[y]->num_child = 1;
+        }
+        node->parent[y]->child[0] = node;
+        node->blocked = 2;
+        node->pp[SLOT(t)] = node->parent[y];
+        return 1;
     }
     
-    return (double) graph->AP.num_blockers - z;
+    return 0;
 }
 
-double update_group_fair(struct graph *graph, double z, int t) {
-    int count = ((int)(z + 0.5));
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->marked == 0 &&
-                graph->AP.blockers[x]->checked == 0) {
-                int success = 0;
-                for (int i = 0; i < graph->AP.blockers[x]->num_blockers; i++) {
-                    if (graph->AP.blockers[x]->blockers[i]->blocked == 0 &&
-                        graph->AP.blockers[x]->blockers[i]->marked == 0) {
-                        if (check_blockage_node(graph->AP.blockers[x], graph->AP.blockers[x]->blockers[i], graph->coordinate, 0) == 0) {
-                            if (graph->AP.blockers[x]->blockers[i]->num_child == 0) {
-                                graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->blockers[i]->num_child = 1;
-                                graph->AP.blockers[x]->idx = i;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->checked = 1;
-                                count++;
-                                z++;
-                                success = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                break;
-                            } else if (graph->AP.blockers[x]->blockers[i]->child[0]->marked == 0 &&
-                                       graph->AP.blockers[x]->blockers[i]->child[0]->blocked > 0) {
-                                if (graph->AP.blockers[x]->blockers[i]->child[0]->traversed == 1) {
-                                    
-                                    if (graph->AP.blockers[x]->reachability > graph->AP.blockers[x]->blockers[i]->child[0]->reachability) {
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->traversed = 1;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->idx = i;
-                                        success = 1;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                        break;
-                                    } else if (graph->AP.blockers[x]->reachability == graph->AP.blockers[x]->blockers[i]->child[0]->reachability) {
-                                        if (graph->AP.blockers[x]->distance_group[i] <
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->distance_group[graph->AP.blockers[x]->blockers[i]->child[0]->idx]) {
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                            graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                            
-                                            graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->idx = i;
-                                            success = 1;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                            break;
-                                        } else if (graph->AP.blockers[x]->distance_group[i] ==
-                                                   graph->AP.blockers[x]->blockers[i]->child[0]->distance_group[graph->AP.blockers[x]->blockers[i]->child[0]->idx]) {
-                                            if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->blockers[i]->child[0]->height) {
-                                                graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                                graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                                graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                                graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                                
-                                                graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                                graph->AP.blockers[x]->traversed = 1;
-                                                graph->AP.blockers[x]->checked = 1;
-                                                graph->AP.blockers[x]->idx = i;
-                                                success = 1;
-                                                graph->AP.blockers[x]->blocked = 2;
-                                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                                break;
-                                            }
-                                        }
-                                    }
-                                } else {
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->blockers[i]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->blockers[i]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->idx = i;
-                                    success = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->blockers[i];
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (success == 0) {
-                    for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                        if (graph->AP.blockers[x]->parent[y]->marked == 0) {
-                            if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 0;
-                                graph->AP.blockers[x]->idx = y;
-                                count++;
-                                z++;
-                                success = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                break;
-                            } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 0 &&
-                                       graph->AP.blockers[x]->parent[y]->child[0]->marked == 0) {
-                                if (graph->AP.blockers[x]->reachability > graph->AP.blockers[x]->parent[y]->child[0]->reachability) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 0;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                    success = 1;
-                                    break;
-                                } else if (graph->AP.blockers[x]->reachability == graph->AP.blockers[x]->parent[y]->child[0]->reachability) {
-                                    if (graph->AP.blockers[x]->distance[y] <
-                                        graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->idx = y;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->traversed = 0;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                        success = 1;
-                                        break;
-                                    } else if (graph->AP.blockers[x]->distance[y] ==
-                                               graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                        if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                            
-                                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->idx = y;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->traversed = 0;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                            success = 1;
-                                            break;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (success == 0) {
-                    int y = 0;
-                    for (int k = 0; k < graph->AP.blockers[x]->num_parent; k++) { //possible to add threshold on distance
-                        if (graph->AP.blockers[x]->parent[k]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[k]->marked == 1) {
-                            if (success == 0) {
-                                success = 1;
-                                y = k;
-                            } else if (graph->AP.blockers[x]->parent[k]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        } else if (graph->AP.blockers[x]->parent[k]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[k]->child[0]->blocked == 0) {
-                            if (success == 0) {
-                                success = 1;
-                                y = k;
-                            } else if (graph->AP.blockers[x]->parent[k]->child[0]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        }
-                    }
-                    
-                    if (success == 1) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->marked == 1) {
-                            //Modify Parent
-                            graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                            
-                            //Modify Node
-                            graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->marked = 0;
-                            graph->AP.blockers[x]->parent[y]->traversed = 0;
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) {
-                            //Modify Child
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->child[0]->marked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                        }
-                        
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->idx = y;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->traversed = 0;
-                        count++;
-                        z++;
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                    } else {
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->reachability++;
-                        count++;
-                    }
-                }
-            }
+double maximal_matching(struct graph *graph, int t) {
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (match(graph, graph->AP.blockers[x], t) == 1) {
+            z++;
+        } else {
+            graph->AP.blockers[x]->reachability++;
         }
-    }
-    
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].marked = 0;
+        clear_traversed(graph);
     }
     
     return (double) graph->AP.num_blockers - z;
 }
 
-double update_stable(struct graph *graph, double z, int t) {
-    double count = z;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {//Stable matching free links
-                    if (graph->AP.blockers[x]->parent[y]->checked == 0) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 1) {
-                            if (graph->AP.blockers[x]->distance[y] <
-                                graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->idx = y;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                break;
-                            } else if (graph->AP.blockers[x]->distance[y] ==
-                                       graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                //fprintf(stderr, "help\n");
-                if (y == graph->AP.blockers[x]->num_parent) { //Find best link among breakable parent-child pair
-                    for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                            //Modify Parent of Node using previous link
-                            graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                            
-                            //Modify Node using previous link
-                            graph->AP.blockers[x]->parent[y]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-
-                            //Update blocked node
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                            //Modify child that is using previous link
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                            
-                            //Update blocked node
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            break;
-                        }
-                    }
-                }
-                //fprintf(stderr, "me\n");
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    count++;
-                    graph->AP.blockers[x]->checked = 1;
-                }
-            }
+//Maximum b-matching: each LOS node relays for up to b blocked nodes, found by augmenting
+//paths in the unit-capacity flow network blocked -> parent -> AP
+double b_matching(struct graph *graph, unsigned int b, int t) {
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (b_match(graph, graph->AP.blockers[x], b, t) == 1) {
+            z++;
+        } else {
+            graph->AP.blockers[x]->reachability++;
         }
-    }
-    
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].traversed = 0;
+        clear_traversed(graph);
     }
     
     return (double) graph->AP.num_blockers - z;
 }
 
-double update_stable_stable(struct graph *graph, double z, int t) {
-    double count = z;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {//Stable matching free links
-                    if (graph->AP.blockers[x]->parent[y]->checked == 0) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 1) {
-                            if (graph->AP.blockers[x]->distance[y] <
-                                graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->idx = y;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                break;
-                            } else if (graph->AP.blockers[x]->distance[y] ==
-                                       graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) { //Find best link among breakable parent-child pair
-                    int found = 0;
-                    y = 0;
-                    for (int k = 0; k < graph->AP.blockers[x]->num_parent; k++) { //possible to add threshold on distance
-                        if (graph->AP.blockers[x]->parent[k]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[k]->checked == 1) {
-                            if (found == 0) {
-                                found = 1;
-                                y = k;
-                            } else if (graph->AP.blockers[x]->parent[k]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        } else if (graph->AP.blockers[x]->parent[k]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[k]->child[0]->blocked == 0) {
-                            if (found == 0) {
-                                found = 1;
-                                y = k;
-                            } else if (graph->AP.blockers[x]->parent[k]->child[0]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        }
-                    }
-                    
-                    if (found == 1) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                            //Modify Parent of Node using previous link
-                            graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                            
-                            //Modify Node using previous link
-                            graph->AP.blockers[x]->parent[y]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                            //Modify child that is using previous link
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                        }
-                        
-                        //Update blocked node
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->idx = y;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->traversed = 1;
-                        count++;
-                        z++;
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                    } else {
-                        count++;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->reachability++;
-                    }
-                }
+double update_perfect(struct graph *graph, int t) {
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 0) {
+            if (update_match(graph, graph->AP.blockers[x], t) == 1) {
+                z++;
+                graph->AP.blockers[x]->blocked = 2;
+            } else {
+                graph->AP.blockers[x]->reachability++;
             }
+            clear_traversed(graph);
+        } else {
+            z++;
+            graph->AP.blockers[x]->blocked = 2;
         }
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].traversed = 0;
-    }
+    clear_checked(graph);
     
     return (double) graph->AP.num_blockers - z;
 }
 
-double update_stable_fair(struct graph *graph, double z, int t) {
-    double count = z;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {//Stable matching free links
-                    if (graph->AP.blockers[x]->parent[y]->checked == 0) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 1) {
-                            if (graph->AP.blockers[x]->reachability > graph->AP.blockers[x]->parent[y]->child[0]->reachability) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->idx = y;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                break;
-                            } else if (graph->AP.blockers[x]->reachability == graph->AP.blockers[x]->parent[y]->child[0]->reachability) {
-                                if (graph->AP.blockers[x]->distance[y] <
-                                    graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                    break;
-                                } else if (graph->AP.blockers[x]->distance[y] ==
-                                           graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                                        
-                                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->idx = y;
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->traversed = 1;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) { //Find best link among breakable parent-child pair
-                    int found = 0;
-                    y = 0;
-                    for (int k = 0; k < graph->AP.blockers[x]->num_parent; k++) { //possible to add threshold on distance
-                        if (graph->AP.blockers[x]->parent[k]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[k]->checked == 1) {
-                            if (found == 0) {
-                                y = k;
-                                found = 1;
-                            } else if (graph->AP.blockers[x]->parent[k]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        } else if (graph->AP.blockers[x]->parent[k]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[k]->child[0]->blocked == 0) {
-                            if (found == 0) {
-                                y = k;
-                                found = 1;
-                            } else if (graph->AP.blockers[x]->parent[k]->child[0]->stability < graph->AP.blockers[x]->parent[y]->stability) {
-                                y = k;
-                            }
-                        }
-                    }
-                    
-                    if (found == 1) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                            //Modify Parent of Node using previous link
-                            graph->AP.blockers[x]->parent[y]->pp[t]->num_child = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t]->child[0] = NULL;
-                            
-                            //Modify Node using previous link
-                            graph->AP.blockers[x]->parent[y]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->pp[t] = NULL;
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                            //Modify child that is using previous link
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->pp[t] = NULL;
-                        }
-                        
-                        //Update blocked node
-                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                        graph->AP.blockers[x]->idx = y;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->traversed = 1;
-                        count++;
-                        z++;
-                        graph->AP.blockers[x]->blocked = 2;
-                        graph->AP.blockers[x]->pp[t] = graph->AP.blockers[x]->parent[y];
-                    } else {
-                        count++;
-                        graph->AP.blockers[x]->checked = 1;
-                        graph->AP.blockers[x]->reachability++;
-                    }
-                }
-            }
+//Repairs the matching update_parents carried over from t-1 instead of rebuilding it:
+//kept links are only counted and augmenting paths start from the blocked nodes that
+//lost theirs. Within a pass a failed search keeps its traversed marks, since nothing
+//it visited can reach a free parent until an augmentation changes the matching.
+double update_perfect_dynamic(struct graph *graph, int t) {
+    double z = 0;
+    int left = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) { //Augment without breaking kept links
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 1) {
+            z++;
+            graph->AP.blockers[x]->blocked = 2;
+        } else if (skip_match(graph, graph->AP.blockers[x], t) == 1) {
+            z++;
+            clear_traversed(graph);
+        } else {
+            left++;
         }
     }
+    clear_traversed(graph);
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-        graph->people[x].traversed = 0;
+    for (int x = 0; x < graph->AP.num_blockers && left > 0; x++) { //Break kept links for the rest
+        if (graph->AP.blockers[x]->blocked != 2) {
+            if (all_match(graph, graph->AP.blockers[x], t) == 1) {
+                z++;
+                left--;
+                clear_traversed(graph);
+            } else {
+                graph->AP.blockers[x]->reachability++;
+            }
+        }
     }
+    clear_traversed(graph);
+    
+    clear_checked(graph);
     
     return (double) graph->AP.num_blockers - z;
-}
-
-//parent preference: height
-//outdated
-double update_stable_height(struct graph *graph, double z) {
-    double count = z;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {//Stable matching free links
-                    if (graph->AP.blockers[x]->parent[y]->checked == 0) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 1) {
-                            if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->idx = y;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 1;
-                                graph->AP.blockers[x]->blocked = 2;
-                                break;
-                            } else if (graph->AP.blockers[x]->height ==
-                                       graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                if (graph->AP.blockers[x]->distance[y] <
-                                    graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) { //Find best link among breakable parent-child pair
-                    for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                            graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                            //Modify Parent of Node using previous link
-                            graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->num_child = 0;
-                            graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->child[0] = NULL;
-                            
-                            //Modify Node using previous link
-                            graph->AP.blockers[x]->parent[y]->checked = 0;
-                            memset(graph->AP.blockers[x]->parent[y]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                            memset(graph->AP.blockers[x]->parent[y]->distance, 0 , sizeof(double) * MAX_NODE);
-                            graph->AP.blockers[x]->parent[y]->num_parent = 0;
-                            graph->AP.blockers[x]->parent[y]->idx = 0;
-                            graph->AP.blockers[x]->parent[y]->stability++;
-                            
-                            //Update blocked node
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            break;
-                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                   graph->AP.blockers[x]->parent[y]->checked == 0 &&
-                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                            //Modify child that is using previous link
-                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                            memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                            memset(graph->AP.blockers[x]->parent[y]->child[0]->distance, 0, sizeof(double) * MAX_NODE);
-                            graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
-                            graph->AP.blockers[x]->parent[y]->child[0]->stability++;
-                            //graph->AP.blockers[x]->parent[y]->num_child = 0;
-                            //graph->AP.blockers[x]->parent[y]->child[0] = NULL;
-                            
-                            //Update blocked node
-                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                            graph->AP.blockers[x]->idx = y;
-                            graph->AP.blockers[x]->checked = 1;
-                            graph->AP.blockers[x]->traversed = 1;
-                            count++;
-                            z++;
-                            graph->AP.blockers[x]->blocked = 2;
-                            break;
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    count++;
-                    graph->AP.blockers[x]->checked = 1;
-                }
+}
+
+double update_perfect_stable(struct graph *graph, int t) {
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 0) {
+            if (update_match_stable(graph, graph->AP.blockers[x], t) == 1) {
+                z++;
+                graph->AP.blockers[x]->blocked = 2;
+            } else {
+                graph->AP.blockers[x]->reachability++;
             }
+            clear_traversed(graph);
+        } else {
+            z++;
+            graph->AP.blockers[x]->blocked = 2;
         }
     }
     
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-        graph->AP.blockers[x]->traversed = 0;
+    clear_checked(graph);
+    
+    return (double) graph->AP.num_blockers - z;
+}
+
+double update_perfect_stable_dynamic(struct graph *graph, int t) {
+    double z = 0;
+    int left = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) { //Augment without breaking kept links
+        if (FLAG(graph->AP.blockers[x]->checked, graph->epoch_checked) == 1) {
+            z++;
+            graph->AP.blockers[x]->blocked = 2;
+        } else if (skip_match(graph, graph->AP.blockers[x], t) == 1) {
+            z++;
+            clear_traversed(graph);
+        } else {
+            left++;
+        }
     }
-    for (int x = 0; x < graph->AP.num_child; x++) {
-        graph->AP.child[x]->checked = 0;
+    clear_traversed(graph);
+    
+    for (int x = 0; x < graph->AP.num_blockers && left > 0; x++) { //Break the least rerouted link for the rest
+        if (graph->AP.blockers[x]->blocked != 2) {
+            if (update_match_stable(graph, graph->AP.blockers[x], t) == 1) {
+                z++;
+                left--;
+            } else {
+                graph->AP.blockers[x]->reachability++;
+            }
+            clear_traversed(graph);
+        }
     }
     
+    clear_checked(graph);
+    
     return (double) graph->AP.num_blockers - z;
 }
 
-//outdated
-double update_stable_close(struct graph *graph, double z) {
-    double count = z;
-    while (count < graph->AP.num_blockers) {
-        for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->height > graph->AP.blockers[x]->height) {
-                        if (graph->AP.blockers[x]->parent[y]->checked == 0) {
-                            if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                graph->AP.blockers[x]->idx = y;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 1;
-                                count++;
-                                z++;
-                                graph->AP.blockers[x]->blocked = 2;
-                                break;
-                            } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 1) {
-                                if (graph->AP.blockers[x]->distance[y] <
-                                    graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                } else if (graph->AP.blockers[x]->distance[y] ==
-                                           graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                    if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                        
-                                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->traversed = 1;
-                                        graph->AP.blockers[x]->idx = y;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                    }
+//Hopcroft-Karp over blocked x LOS nodes. Blocked nodes are indexed by their
+//position in AP.blockers, LOS nodes by id.
+#define HK_FREE -1
+#define HK_LOCKED -2
+#define HK_INF (MAX_NODE + 1)
+
+struct hk {
+    int index[MAX_NODE]; //id -> position in AP.blockers, -1 if not blocked
+    int mate[MAX_NODE]; //blocked node -> parent id, -1 if unmatched
+    int owner[MAX_NODE]; //parent id -> blocked node, HK_FREE or HK_LOCKED
+    int dist[MAX_NODE];
+    int limit; //layer of the shortest augmenting paths this phase
+};
+
+//Read the current links into hk. With skip set, parents holding a checked
+//(kept) link are left out, as in skip_match.
+void hk_init(struct graph *graph, struct hk *hk, int skip) {
+    for (int x = 0; x < graph->population; x++) {
+        hk->index[x] = -1;
+        hk->owner[x] = HK_LOCKED;
+    }
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        hk->index[graph->AP.blockers[x]->id] = x;
+        hk->mate[x] = -1;
+    }
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+            struct node *parent = graph->AP.blockers[x]->parent[y];
+            if (hk->owner[parent->id] != HK_LOCKED) {
+                continue;
+            }
+            if (parent->num_child == 0) {
+                if (skip == 0 || FLAG(parent->checked, graph->epoch_checked) == 0) {
+                    hk->owner[parent->id] = HK_FREE;
                 }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    double height = graph->AP.blockers[x]->height;
-                    do {
-                        height -= .1;
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            if (graph->AP.blockers[x]->parent[y]->height > height &&
-                                graph->AP.blockers[x]->parent[y]->height <= height + 0.1 &&
-                                graph->AP.blockers[x]->parent[y]->checked == 0) {
-                                if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->idx = y;
-                                    count++;
-                                    z++;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                }
-                            }
-                        }
-                        if (y < graph->AP.blockers[x]->num_parent) {
-                            break;
-                        }
-                    } while (height >= MIN_HEIGHT);
-                    
-                    if (y == graph->AP.blockers[x]->num_parent) { //Worst case
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            if (graph->AP.blockers[x]->parent[y]->height > graph->AP.blockers[x]->height) {
-                                if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                                    graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                                    //Modify Parent of Node using previous link
-                                    graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->num_child = 0;
-                                    graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->child[0] = NULL;
-                                    
-                                    //Modify Node using previous link
-                                    graph->AP.blockers[x]->parent[y]->checked = 0;
-                                    memset(graph->AP.blockers[x]->parent[y]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                    memset(graph->AP.blockers[x]->parent[y]->distance, 0 , sizeof(double) * MAX_NODE);
-                                    graph->AP.blockers[x]->parent[y]->num_parent = 0;
-                                    graph->AP.blockers[x]->parent[y]->idx = 0;
-                                    graph->AP.blockers[x]->parent[y]->stability++;
-                                    
-                                    //Update blocked node
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    count++;
-                                    z++;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                           graph->AP.blockers[x]->parent[y]->checked == 0 &&
-                                           graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                                    //Modify child that is using previous link
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                    memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                    memset(graph->AP.blockers[x]->parent[y]->child[0]->distance, 0, sizeof(double) * MAX_NODE);
-                                    graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->stability++;
-                                    //graph->AP.blockers[x]->parent[y]->num_child = 0;
-                                    //graph->AP.blockers[x]->parent[y]->child[0] = NULL;
-                                    
-                                    //Update blocked node
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    count++;
-                                    z++;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                }
-                            }
-                        }
-                        
-                        if (y == graph->AP.blockers[x]->num_parent) {
-                            double height = graph->AP.blockers[x]->height;
-                            do {
-                                height -= .1;
-                                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                                    if (graph->AP.blockers[x]->parent[y]->height > height &&
-                                        graph->AP.blockers[x]->parent[y]->height <= height + 0.1) {
-                                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                                            graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                                            //Modify Parent of Node using previous link
-                                            graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->num_child = 0;
-                                            graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->child[0] = NULL;
-                                            
-                                            //Modify Node using previous link
-                                            graph->AP.blockers[x]->parent[y]->checked = 0;
-                                            memset(graph->AP.blockers[x]->parent[y]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                            memset(graph->AP.blockers[x]->parent[y]->distance, 0 , sizeof(double) * MAX_NODE);
-                                            graph->AP.blockers[x]->parent[y]->num_parent = 0;
-                                            graph->AP.blockers[x]->parent[y]->idx = 0;
-                                            graph->AP.blockers[x]->parent[y]->stability++;
-                                            
-                                            //Update blocked node
-                                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                            graph->AP.blockers[x]->idx = y;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            count++;
-                                            z++;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            break;
-                                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                                   graph->AP.blockers[x]->parent[y]->checked == 0 &&
-                                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                                            //Modify child that is using previous link
-                                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                            memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                            memset(graph->AP.blockers[x]->parent[y]->child[0]->distance, 0, sizeof(double) * MAX_NODE);
-                                            graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->stability++;
-                                            //graph->AP.blockers[x]->parent[y]->num_child = 0;
-                                            //graph->AP.blockers[x]->parent[y]->child[0] = NULL;
-                                            
-                                            //Update blocked node
-                                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->idx = y;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            count++;
-                                            z++;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            break;
-                                        }
-                                    }
-                                }
-                                if (y < graph->AP.blockers[x]->num_parent) {
-                                    break;
-                                }
-                            } while (height >= MIN_HEIGHT);
-                        }
-                        
-                        if (y == graph->AP.blockers[x]->num_parent) {
-                            count++;
-                            graph->AP.blockers[x]->checked = 1;
-                        }
-                    }
+            } else {
+                int c = parent->child[0]->id >= 0 ? hk->index[parent->child[0]->id] : -1;
+                if (c >= 0) {
+                    hk->mate[c] = parent->id;
+                }
+                if (skip == 1 && FLAG(parent->child[0]->checked, graph->epoch_checked) == 1) {
+                    continue;
+                }
+                if (c >= 0) {
+                    hk->owner[parent->id] = c;
+                } else if (FLAG(parent->child[0]->checked, graph->epoch_checked) == 1) {
+                    hk->owner[parent->id] = HK_FREE; //LOS child can drop its link, as in all_match
                 }
             }
         }
     }
-    
+}
+
+//Layer the unmatched blocked nodes up to the first layer that sees a free parent,
+//returns 1 if there is one
+int hk_bfs(struct graph *graph, struct hk *hk) {
+    int queue[MAX_NODE];
+    int head = 0, tail = 0;
+    hk->limit = HK_INF;
     for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-        graph->AP.blockers[x]->traversed = 0;
+        if (hk->mate[x] == -1) {
+            hk->dist[x] = 0;
+            queue[tail++] = x;
+        } else {
+            hk->dist[x] = HK_INF;
+        }
     }
-    for (int x = 0; x < graph->AP.num_child; x++) {
-        graph->AP.child[x]->checked = 0;
+    while (head < tail) {
+        int x = queue[head++];
+        if (hk->dist[x] > hk->limit) {
+            break;
+        }
+        for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+            int o = hk->owner[graph->AP.blockers[x]->parent[y]->id];
+            if (o == HK_FREE) {
+                hk->limit = hk->dist[x];
+            } else if (o >= 0 && hk->dist[o] == HK_INF && hk->dist[x] < hk->limit) {
+                hk->dist[o] = hk->dist[x] + 1;
+                queue[tail++] = o;
+            }
+        }
     }
-    
-    return (double) graph->AP.num_blockers - z;
+    return hk->limit != HK_INF;
 }
 
-//parent preference: height
-//outdated
-double update_stable_close_height(struct graph *graph, double z) {
-    double count = z;
-    while (count < graph->AP.num_blockers) {
+//Augment along a shortest path from x: free parents only count at the last layer
+int hk_dfs(struct graph *graph, struct hk *hk, int x) {
+    for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+        int id = graph->AP.blockers[x]->parent[y]->id;
+        int o = hk->owner[id];
+        if (hk->dist[x] == hk->limit ? o == HK_FREE :
+            o >= 0 && hk->dist[o] == hk->dist[x] + 1 && hk_dfs(graph, hk, o)) {
+            hk->owner[id] = x;
+            hk->mate[x] = id;
+            return 1;
+        }
+    }
+    hk->dist[x] = HK_INF;
+    return 0;
+}
+
+//Returns number of blocked nodes matched
+int hk_run(struct graph *graph, struct hk *hk) {
+    while (hk_bfs(graph, hk)) {
         for (int x = 0; x < graph->AP.num_blockers; x++) {
-            if (graph->AP.blockers[x]->checked == 0) {
-                int y;
-                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                    if (graph->AP.blockers[x]->parent[y]->height > graph->AP.blockers[x]->height) {
-                        if (graph->AP.blockers[x]->parent[y]->checked == 0) {
-                            if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                graph->AP.blockers[x]->idx = y;
-                                graph->AP.blockers[x]->checked = 1;
-                                graph->AP.blockers[x]->traversed = 1;
-                                count++;
-                                z++;
-                                graph->AP.blockers[x]->blocked = 2;
-                                break;
-                            } else if (graph->AP.blockers[x]->parent[y]->child[0]->traversed == 1) {
-                                if (graph->AP.blockers[x]->height > graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                    
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                } else if (graph->AP.blockers[x]->height ==
-                                           graph->AP.blockers[x]->parent[y]->child[0]->height) {
-                                    if (graph->AP.blockers[x]->distance[y] <
-                                        graph->AP.blockers[x]->parent[y]->child[0]->distance[graph->AP.blockers[x]->parent[y]->child[0]->idx]) {
-                                        graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->traversed = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                        graph->AP.blockers[x]->parent[y]->child[0]->blocked = 1;
-                                        
-                                        graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                        graph->AP.blockers[x]->checked = 1;
-                                        graph->AP.blockers[x]->traversed = 1;
-                                        graph->AP.blockers[x]->idx = y;
-                                        graph->AP.blockers[x]->blocked = 2;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-                
-                if (y == graph->AP.blockers[x]->num_parent) {
-                    double height = graph->AP.blockers[x]->height;
-                    do {
-                        height -= .1;
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            if (graph->AP.blockers[x]->parent[y]->height > height &&
-                                graph->AP.blockers[x]->parent[y]->height <= height + 0.1 &&
-                                graph->AP.blockers[x]->parent[y]->checked == 0) {
-                                if (graph->AP.blockers[x]->parent[y]->num_child == 0) {
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    graph->AP.blockers[x]->idx = y;
-                                    count++;
-                                    z++;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                }
-                            }
-                        }
-                        if (y < graph->AP.blockers[x]->num_parent) {
-                            break;
-                        }
-                    } while (height >= MIN_HEIGHT);
-                    
-                    if (y == graph->AP.blockers[x]->num_parent) { //Worst case
-                        for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                            if (graph->AP.blockers[x]->parent[y]->height > graph->AP.blockers[x]->height) {
-                                if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                                    graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                                    //Modify Parent of Node using previous link
-                                    graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->num_child = 0;
-                                    graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->child[0] = NULL;
-                                    
-                                    //Modify Node using previous link
-                                    graph->AP.blockers[x]->parent[y]->checked = 0;
-                                    memset(graph->AP.blockers[x]->parent[y]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                    memset(graph->AP.blockers[x]->parent[y]->distance, 0 , sizeof(double) * MAX_NODE);
-                                    graph->AP.blockers[x]->parent[y]->num_parent = 0;
-                                    graph->AP.blockers[x]->parent[y]->idx = 0;
-                                    graph->AP.blockers[x]->parent[y]->stability++;
-                                    
-                                    //Update blocked node
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    count++;
-                                    z++;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                           graph->AP.blockers[x]->parent[y]->checked == 0 &&
-                                           graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                                    //Modify child that is using previous link
-                                    graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                    memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                    memset(graph->AP.blockers[x]->parent[y]->child[0]->distance, 0, sizeof(double) * MAX_NODE);
-                                    graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
-                                    graph->AP.blockers[x]->parent[y]->child[0]->stability++;
-                                    //graph->AP.blockers[x]->parent[y]->num_child = 0;
-                                    //graph->AP.blockers[x]->parent[y]->child[0] = NULL;
-                                    
-                                    //Update blocked node
-                                    graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                    graph->AP.blockers[x]->idx = y;
-                                    graph->AP.blockers[x]->checked = 1;
-                                    graph->AP.blockers[x]->traversed = 1;
-                                    count++;
-                                    z++;
-                                    graph->AP.blockers[x]->blocked = 2;
-                                    break;
-                                }
-                            }
-                        }
-                        
-                        if (y == graph->AP.blockers[x]->num_parent) {
-                            double height = graph->AP.blockers[x]->height;
-                            do {
-                                height -= .1;
-                                for (y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
-                                    if (graph->AP.blockers[x]->parent[y]->height > height &&
-                                        graph->AP.blockers[x]->parent[y]->height <= height + 0.1) {
-                                        if (graph->AP.blockers[x]->parent[y]->num_child == 0 &&
-                                            graph->AP.blockers[x]->parent[y]->checked == 1) { //Best link, force parent to use LOS
-                                            //Modify Parent of Node using previous link
-                                            graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->num_child = 0;
-                                            graph->AP.blockers[x]->parent[y]->parent[graph->AP.blockers[x]->parent[y]->idx]->child[0] = NULL;
-                                            
-                                            //Modify Node using previous link
-                                            graph->AP.blockers[x]->parent[y]->checked = 0;
-                                            memset(graph->AP.blockers[x]->parent[y]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                            memset(graph->AP.blockers[x]->parent[y]->distance, 0 , sizeof(double) * MAX_NODE);
-                                            graph->AP.blockers[x]->parent[y]->num_parent = 0;
-                                            graph->AP.blockers[x]->parent[y]->idx = 0;
-                                            graph->AP.blockers[x]->parent[y]->stability++;
-                                            
-                                            //Update blocked node
-                                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->parent[y]->num_child = 1;
-                                            graph->AP.blockers[x]->idx = y;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            count++;
-                                            z++;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            break;
-                                        } else if (graph->AP.blockers[x]->parent[y]->num_child == 1 &&
-                                                   graph->AP.blockers[x]->parent[y]->checked == 0 &&
-                                                   graph->AP.blockers[x]->parent[y]->child[0]->blocked == 0) { //Best link, force parent to route to us
-                                            //Modify child that is using previous link
-                                            graph->AP.blockers[x]->parent[y]->child[0]->checked = 0;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->idx = 0;
-                                            memset(graph->AP.blockers[x]->parent[y]->child[0]->parent, 0, sizeof(struct node *) * MAX_NODE);
-                                            memset(graph->AP.blockers[x]->parent[y]->child[0]->distance, 0, sizeof(double) * MAX_NODE);
-                                            graph->AP.blockers[x]->parent[y]->child[0]->num_parent = 0;
-                                            graph->AP.blockers[x]->parent[y]->child[0]->stability++;
-                                            //graph->AP.blockers[x]->parent[y]->num_child = 0;
-                                            //graph->AP.blockers[x]->parent[y]->child[0] = NULL;
-                                            
-                                            //Update blocked node
-                                            graph->AP.blockers[x]->parent[y]->child[0] = graph->AP.blockers[x];
-                                            graph->AP.blockers[x]->idx = y;
-                                            graph->AP.blockers[x]->checked = 1;
-                                            graph->AP.blockers[x]->traversed = 1;
-                                            count++;
-                                            z++;
-                                            graph->AP.blockers[x]->blocked = 2;
-                                            break;
-                                        }
-                                    }
-                                }
-                                if (y < graph->AP.blockers[x]->num_parent) {
-                                    break;
-                                }
-                            } while (height >= MIN_HEIGHT);
-                        }
-                        
-                        if (y == graph->AP.blockers[x]->num_parent) {
-                            count++;
-                            graph->AP.blockers[x]->checked = 1;
-                        }
-                    }
-                }
+            if (hk->mate[x] == -1) {
+                hk_dfs(graph, hk, x);
             }
         }
     }
-    
+    int z = 0;
     for (int x = 0; x < graph->AP.num_blockers; x++) {
-        graph->AP.blockers[x]->checked = 0;
-        graph->AP.blockers[x]->traversed = 0;
+        if (hk->mate[x] != -1) {
+            z++;
+        }
     }
-    for (int x = 0; x < graph->AP.num_child; x++) {
-        graph->AP.child[x]->checked = 0;
+    return z;
+}
+
+//Write the matching back as links, releasing any LOS node that lost its parent or child
+void hk_apply(struct graph *graph, struct hk *hk, int t) {
+    for (int id = 0; id < graph->population; id++) {
+        if (hk->owner[id] < 0) {
+            continue;
+        }
+        struct node *parent = &graph->people[id];
+        struct node *node = graph->AP.blockers[hk->owner[id]];
+        if (parent->num_child == 1 && parent->child[0] != node &&
+            parent->child[0]->blocked == 0) {
+            parent->child[0]->checked = 0;
+            parent->child[0]->pp[SLOT(t)] = NULL;
+        }
+        if (parent->num_child == 0 && FLAG(parent->checked, graph->epoch_checked) == 1 &&
+            parent->pp[SLOT(t)] != NULL) {
+            parent->pp[SLOT(t)]->num_child = 0;
+            parent->pp[SLOT(t)]->child[0] = NULL;
+            parent->pp[SLOT(t)] = NULL;
+            parent->checked = 0;
+        }
+        parent->child[0] = node;
+        parent->num_child = 1;
+        node->pp[SLOT(t)] = parent;
+        node->blocked = 2;
+    }
+}
+
+double maximal_matching_hk(struct graph *graph, int t) {
+    struct hk hk;
+    hk_init(graph, &hk, 0);
+    double z = hk_run(graph, &hk);
+    hk_apply(graph, &hk, t);
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (hk.mate[x] == -1) {
+            graph->AP.blockers[x]->reachability++;
+        }
     }
     
     return (double) graph->AP.num_blockers - z;
 }
 
-void update_graph(int width, int length, struct graph *graph) {
-    for (int x = 0; x < graph->population; x++) {
-        int dir = rand() % 9;
-        int increment = 1;
-        switch (dir) {
-            case 0:
-                while (graph->people[x].y + increment < length) {
-                    if (graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y + increment] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y + increment] = &graph->people[x];
-                        graph->people[x].y += increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 1:
-                while (graph->people[x].y + increment < length &&
-                       graph->people[x].x + increment < width) {
-                    if (graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y + increment] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y + increment] = &graph->people[x];
-                        graph->people[x].y += increment;
-                        graph->people[x].x += increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 2:
-                while (graph->people[x].x + increment < width) {
-                    if (graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y] = &graph->people[x];
-                        graph->people[x].x += increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 3:
-                while (graph->people[x].y - increment >= 0 &&
-                       graph->people[x].x + increment < width) {
-                    if (graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y - increment] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x + increment][(int)graph->people[x].y - increment] = &graph->people[x];
-                        graph->people[x].y -= increment;
-                        graph->people[x].x += increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 4:
-                while (graph->people[x].y - increment >= 0) {
-                    if (graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y - increment] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y - increment] = &graph->people[x];
-                        graph->people[x].y -= increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 5:
-                while (graph->people[x].y - increment >= 0 &&
-                       graph->people[x].x - increment >= 0) {
-                    if (graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y - increment] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y - increment] = &graph->people[x];
-                        graph->people[x].y -= increment;
-                        graph->people[x].x -= increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 6:
-                while (graph->people[x].x - increment >= 0) {
-                    if (graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y] = &graph->people[x];
-                        graph->people[x].x -= increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 7:
-                while (graph->people[x].y + increment < length &&
-                       graph->people[x].x - increment >= 0) {
-                    if (graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y + increment] == NULL) {
-                        graph->coordinate[(int)graph->people[x].x][(int)graph->people[x].y] = NULL;
-                        graph->coordinate[(int)graph->people[x].x - increment][(int)graph->people[x].y + increment] = &graph->people[x];
-                        graph->people[x].y += increment;
-                        graph->people[x].x -= increment;
-                        break;
-                    }
-                    increment++;
-                }
-                break;
-                
-            case 8:
-            default:
-                break;
+double update_perfect_hk(struct graph *graph, int t) {
+    struct hk hk;
+    hk_init(graph, &hk, 1);
+    double z = hk_run(graph, &hk);
+    hk_apply(graph, &hk, t);
+    if (z < graph->AP.num_blockers) { //Break kept links only if needed, as in all_match
+        hk_init(graph, &hk, 0);
+        z = hk_run(graph, &hk);
+        hk_apply(graph, &hk, t);
+    }
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (hk.mate[x] == -1) {
+            graph->AP.blockers[x]->reachability++;
+        } else {
+            graph->AP.blockers[x]->blocked = 2;
+        }
+    }
+    
+    clear_checked(graph);
+    
+    return (double) graph->AP.num_blockers - z;
+}
+
+//Augmenting path for relay_routing: candidate tails of u are cand[u][0..num[u]), holder[tail]
+//is the node currently attached to it. Tails are the ids of reached nodes with no child.
+int relay_augment(int u, int num[MAX_NODE], int cand[MAX_NODE][MAX_NODE], int holder[MAX_NODE], int seen[MAX_NODE], int stamp) {
+    for (int k = 0; k < num[u]; k++) {
+        int tail = cand[u][k];
+        if (seen[tail] != stamp) {
+            seen[tail] = stamp;
+            if (holder[tail] == -1 || relay_augment(holder[tail], num, cand, holder, seen, stamp) == 1) {
+                holder[tail] = u;
+                return 1;
+            }
         }
     }
+    return 0;
 }
 
-void update_graph_waypoint_group(int width, int length, struct graph *graph) {
+//Relay chains of up to depth hops, built in BFS layers from the LOS set. Layer 1 is a maximum
+//matching of blocked nodes to their LOS parents (in parent order, like maximal_matching); each
+//further layer matches the nodes still unreached to reached nodes that have no child yet, so
+//every relay keeps one child and a node is reached at its fewest possible hops given the
+//layers before it. Within a layer candidates are tried by predicted chain rate when
+//capacity == 1, nearest first otherwise. Returns the number of nodes left unreached.
+double relay_routing(struct graph *graph, int depth, int capacity, int t) {
+    int layer[MAX_NODE];
+    double rate[MAX_NODE]; //predicted rate of reached nodes
     for (int x = 0; x < graph->population; x++) {
-        if (graph->people[x].person == 0) {
-            continue;
+        layer[x] = -1;
+    }
+    for (int x = 0; x < graph->AP.num_child; x++) {
+        layer[graph->AP.child[x]->id] = 0;
+        rate[graph->AP.child[x]->id] = graph->AP.child[x]->capacity > LIMIT ? LIMIT : graph->AP.child[x]->capacity;
+    }
+    
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (match(graph, graph->AP.blockers[x], t) == 1) {
+            z++;
         }
-        if ((graph->people[x].x != graph->people[x].x_dest) ||
-            (graph->people[x].y != graph->people[x].y_dest)) {
-            if (graph->people[x].x != graph->people[x].x_dest) {
-                double increment = 1;
-                if (graph->people[x].x_dest < graph->people[x].x) {
-                    while (graph->people[x].x - increment >= 0) {
-                        if (graph->coordinate[(int)(graph->people[x].x - increment + 0.5)][(int)(graph->people[x].y + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].x - increment + 0.5)][(int)(graph->people[x].y + 0.5)] = &graph->people[x];
-                            graph->people[x].x -= increment;
-                            break;
-                        }
-                        increment++;
-                    }
-                    
-                    graph->people[x].timer++;
-                } else {
-                    while (graph->people[x].x + increment < width) {
-                        if (graph->coordinate[(int)(graph->people[x].x + increment + 0.5)][(int)(graph->people[x].y + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].x + increment + 0.5)][(int)(graph->people[x].y + 0.5)] = &graph->people[x];
-                            graph->people[x].x += increment;
-                            break;
-                        }
-                        increment++;
-                    }
-                    
-                    graph->people[x].timer++;
-                }
+        clear_traversed(graph);
+    }
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        struct node *node = graph->AP.blockers[x];
+        if (node->blocked == 2) {
+            struct node *parent = node->pp[SLOT(t)];
+            layer[node->id] = 1;
+            rate[parent->id] /= 2;
+            rate[node->id] = mean_capacity(parent, node);
+            if (rate[node->id] > rate[parent->id]) {
+                rate[node->id] = rate[parent->id];
             }
-            if (graph->people[x].y != graph->people[x].y_dest) {
-                double increment = 1;
-                if (graph->people[x].y_dest < graph->people[x].y) {
-                    while (graph->people[x].y - increment >= 0) {
-                        if (graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y - increment + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y - increment + 0.5)] = &graph->people[x];
-                            graph->people[x].y -= increment;
-                            break;
-                        }
-                        increment++;
-                    }
-                    
-                    graph->people[x].timer++;
-                } else {
-                    while (graph->people[x].y + increment < length) {
-                        if (graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + increment + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].x + 0.5)][(int)(graph->people[x].y + increment + 0.5)] = &graph->people[x];
-                            graph->people[x].y += increment;
-                            break;
-                        }
-                        increment++;
-                    }
-                    
-                    graph->people[x].timer++;
-                }
+        }
+    }
+    
+    int num[MAX_NODE], cand[MAX_NODE][MAX_NODE], holder[MAX_NODE], seen[MAX_NODE] = {0};
+    double key[MAX_NODE][MAX_NODE];
+    int stamp = 0;
+    for (int d = 2; d <= depth && z < graph->AP.num_blockers; d++) {
+        for (int x = 0; x < graph->population; x++) {
+            holder[x] = -1;
+        }
+        for (int x = 0; x < graph->AP.num_blockers; x++) {
+            struct node *node = graph->AP.blockers[x];
+            num[node->id] = 0;
+            if (layer[node->id] != -1) {
+                continue;
             }
-            
-            for (int y = 0; y < graph->people[x].num_blockers; y++) {
-                int chx = 0, chy = 0;
-                if (((int) (graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5) >= 0) &&
-                    ((int) (graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5) < length)) {
-                    if (graph->people[x].x + graph->people[x].blockers[y]->x_dest != graph->people[x].blockers[y]->x) {
-                        chx = 1;
-                    }
-                }
-                
-                if (((int) (graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5) >= 0) &&
-                    ((int) (graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5) < width)) {
-                    if (graph->people[x].y + graph->people[x].blockers[y]->y_dest != graph->people[x].blockers[y]->y) {
-                        chy = 1;
-                    }
+            for (int y = 0; y < graph->population; y++) {
+                struct node *tail = &graph->people[y];
+                if (layer[y] == -1 || tail->num_child > 0 ||
+                    check_blockage_node(node, tail, graph->coordinate, 0) == 1) {
+                    continue;
                 }
-                
-                if (chx == 1) {
-                    if (chy == 1) {
-                        if (graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] = graph->people[x].blockers[y];
-                            graph->people[x].blockers[y]->x = graph->people[x].x + graph->people[x].blockers[y]->x_dest;
-                            graph->people[x].blockers[y]->y = graph->people[x].y + graph->people[x].blockers[y]->y_dest;
-                        }
-                    } else {
-                        if (graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].x + graph->people[x].blockers[y]->x_dest + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)]= graph->people[x].blockers[y];
-                            graph->people[x].blockers[y]->x = graph->people[x].x + graph->people[x].blockers[y]->x_dest;
-                        }
-                    }
+                double k;
+                if (capacity == 1) {
+                    double link = mean_capacity(tail, node);
+                    k = -(link < rate[y] / 2 ? link : rate[y] / 2);
                 } else {
-                    if (chy == 1) {
-                        if (graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] == NULL) {
-                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].blockers[y]->y + 0.5)] = NULL;
-                            graph->coordinate[(int)(graph->people[x].blockers[y]->x + 0.5)][(int)(graph->people[x].y + graph->people[x].blockers[y]->y_dest + 0.5)] = graph->people[x].blockers[y];
-                            graph->people[x].blockers[y]->y = graph->people[x].y + graph->people[x].blockers[y]->y_dest;
-                        }
-                    }
+                    k = distance(node, tail);
+                }
+                int c = num[node->id]++;
+                while (c > 0 && key[node->id][c - 1] > k) { //keep candidates sorted by key
+                    key[node->id][c] = key[node->id][c - 1];
+                    cand[node->id][c] = cand[node->id][c - 1];
+                    c--;
                 }
+                key[node->id][c] = k;
+                cand[node->id][c] = y;
             }
-            
-            if (graph->people[x].timer >= length || graph->people[x].timer >= width) {
-                graph->people[x].timer = 0;
-                do {
-                    graph->people[x].x_dest = rand() % width;
-                    graph->people[x].y_dest = rand() % length;
-                } while (graph->people[x].x_dest == graph->AP.x && graph->people[x].y_dest == graph->AP.y);
+        }
+        
+        int found = 0;
+        for (int x = 0; x < graph->AP.num_blockers; x++) {
+            int u = graph->AP.blockers[x]->id;
+            if (layer[u] == -1 && num[u] > 0) {
+                found += relay_augment(u, num, cand, holder, seen, ++stamp);
             }
-        } else if (graph->people[x].timer > 0) {
-            if (graph->people[x].timer > 5) {
-                graph->people[x].timer = rand() % 5;
+        }
+        if (found == 0) {
+            break;
+        }
+        
+        for (int y = 0; y < graph->population; y++) {
+            if (holder[y] == -1) {
+                continue;
             }
-            graph->people[x].timer--;
-        } else {
-            do {
-                graph->people[x].x_dest = rand() % width;
-                graph->people[x].y_dest = rand() % length;
-            } while (graph->people[x].x_dest == graph->AP.x && graph->people[x].y_dest == graph->AP.y);
+            struct node *tail = &graph->people[y];
+            struct node *node = &graph->people[holder[y]];
+            tail->child[0] = node;
+            tail->num_child = 1;
+            node->pp[SLOT(t)] = tail;
+            node->blocked = 2;
+            layer[node->id] = d;
+            rate[y] /= 2;
+            rate[node->id] = mean_capacity(tail, node);
+            if (rate[node->id] > rate[y]) {
+                rate[node->id] = rate[y];
+            }
+            z++;
+        }
+    }
+    
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (graph->AP.blockers[x]->blocked != 2) {
+            graph->AP.blockers[x]->reachability++;
         }
     }
+    
+    return (double) graph->AP.num_blockers - z;
 }
 
-void shift_index(struct graph *graph) {
-    struct node *temp = graph->rr[0];
-    for (int x = 0; x < graph->population - 1; x++) {
-        graph->rr[x] = graph->rr[x+1];
-    }
-    graph->rr[graph->population - 1] = temp;
+//Change in aggregate data rate (Gbps) when LOS parent relays for child, following
+//update_capacity_delay: the parent drops to half its AP rate and the child gets the
+//parent-to-child rate capped at that
+double relay_gain(struct node *parent, struct node *child) {
+    double own = parent->capacity > LIMIT ? LIMIT : parent->capacity;
+    double half = parent->capacity / 2 > LIMIT ? LIMIT : parent->capacity / 2;
+    double link = mean_capacity(parent, child);
+    return ((link < half ? link : half) - (own - half)) / 1000000000;
 }
 
-void sort_height_index(struct graph *graph) {
-    struct node *temp = NULL;
-    for (int x = 0; x < graph->population; x++) {
-        for (int y = x + 1; y < graph->population; y++) {
-            if (graph->rr[x]->height > graph->rr[y]->height) {
-                temp = graph->rr[y];
-                graph->rr[y] = graph->rr[x];
-                graph->rr[x] = temp;
+//Every extra matched node outweighs any difference in relay gain
+#define WEIGHT_BASE (2.0 * LIMIT / 1000000000 * MAX_NODE)
+
+//Fills value[x][j] with the weight of relaying blocked node x through LOS node AP.child[j]
+//and edge[x][j] with the index of that parent in x's list, or -1 if x cannot use it
+void relay_weights(struct graph *graph, int edge[MAX_NODE][MAX_NODE], double value[MAX_NODE][MAX_NODE]) {
+    int col[MAX_NODE];
+    for (int j = 0; j < graph->AP.num_child; j++) {
+        col[graph->AP.child[j]->id] = j;
+    }
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        for (int j = 0; j < graph->AP.num_child; j++) {
+            value[x][j] = 0;
+            edge[x][j] = -1;
+        }
+        for (int y = 0; y < graph->AP.blockers[x]->num_parent; y++) {
+            int j = col[graph->AP.blockers[x]->parent[y]->id];
+            double w = WEIGHT_BASE + relay_gain(graph->AP.blockers[x]->parent[y], graph->AP.blockers[x]);
+            if (edge[x][j] == -1 || w > value[x][j]) {
+                value[x][j] = w;
+                edge[x][j] = y;
             }
         }
     }
 }
 
-void sort_stability(struct graph *graph) {
-    struct node *temp = NULL;
-    for (int x = 0; x < graph->population; x++) {
-        for (int y = x + 1; y < graph->population; y++) {
-            if (graph->rr[x]->stability < graph->rr[y]->stability) {
-                temp = graph->rr[y];
-                graph->rr[y] = graph->rr[x];
-                graph->rr[x] = temp;
+//Hungarian method (successive shortest paths with potentials) on the n x m weights from
+//relay_weights: maximizes the number matched, then the total value. assign[x] is the index
+//in AP.blockers[x]->parent or -1. Returns the total value above WEIGHT_BASE.
+double hungarian(int n, int m, int edge[MAX_NODE][MAX_NODE], double value[MAX_NODE][MAX_NODE], int assign[MAX_NODE]) {
+    int size = n > m ? n : m;
+    double cost[MAX_NODE + 1][MAX_NODE + 1];
+    for (int i = 0; i <= size; i++) {
+        for (int j = 0; j <= size; j++) {
+            cost[i][j] = 0;
+        }
+    }
+    for (int x = 0; x < n; x++) {
+        assign[x] = -1;
+        for (int j = 0; j < m; j++) {
+            cost[x + 1][j + 1] = -value[x][j];
+        }
+    }
+    
+    //Potentials u (rows) and v (columns), p[j] is the row assigned to column j
+    double u[MAX_NODE + 1] = {0}, v[MAX_NODE + 1] = {0}, minv[MAX_NODE + 1];
+    int p[MAX_NODE + 1] = {0}, way[MAX_NODE + 1], used[MAX_NODE + 1];
+    for (int i = 1; i <= size; i++) {
+        int j0 = 0;
+        p[0] = i;
+        for (int j = 0; j <= size; j++) {
+            minv[j] = INFINITY;
+            used[j] = 0;
+        }
+        do {
+            int i0 = p[j0], j1 = 0;
+            double delta = INFINITY;
+            used[j0] = 1;
+            for (int j = 1; j <= size; j++) {
+                if (used[j] == 0) {
+                    double cur = cost[i0][j] - u[i0] - v[j];
+                    if (cur < minv[j]) {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if (minv[j] < delta) {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+            }
+            for (int j = 0; j <= size; j++) {
+                if (used[j] == 1) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
             }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+    
+    double gain = 0;
+    for (int j = 1; j <= m; j++) {
+        if (p[j] >= 1 && p[j] <= n && edge[p[j] - 1][j - 1] >= 0) {
+            assign[p[j] - 1] = edge[p[j] - 1][j - 1];
+            gain += value[p[j] - 1][j - 1] - WEIGHT_BASE;
         }
     }
+    return gain;
 }
 
-void sort_reachability(struct graph *graph) {
-    struct node *temp = NULL;
-    for (int x = 0; x < graph->population; x++) {
-        for (int y = x + 1; y < graph->population; y++) {
-            if (graph->rr[x]->reachability < graph->rr[y]->reachability) {
-                temp = graph->rr[y];
-                graph->rr[y] = graph->rr[x];
-                graph->rr[x] = temp;
-            }
+//Links each blocked node to the parent picked in assign, returns the number left unmatched
+double apply_assign(struct graph *graph, int assign[MAX_NODE], int t) {
+    double z = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        if (assign[x] >= 0) {
+            struct node *parent = graph->AP.blockers[x]->parent[assign[x]];
+            parent->child[0] = graph->AP.blockers[x];
+            parent->num_child = 1;
+            graph->AP.blockers[x]->pp[SLOT(t)] = parent;
+            graph->AP.blockers[x]->blocked = 2;
+            z++;
+        } else {
+            graph->AP.blockers[x]->reachability++;
         }
     }
+    
+    return (double) graph->AP.num_blockers - z;
 }
 
-void reset(struct graph *graph) {
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].traversed = 0;
-        graph->people[x].idx = 0;
-        graph->people[x].checked = 0;
-        graph->people[x].num_child = 0;
-        graph->people[x].child[0] = NULL;
-        memset(graph->people[x].parent, 0, sizeof(struct node *) * MAX_NODE);
-        memset(graph->people[x].distance, 0, sizeof(double) * MAX_NODE);
-        graph->people[x].num_parent = 0;
-    }
+//Hungarian assignment of blocked nodes to LOS parents maximizing the number matched, then
+//the total relay_gain. Returns the gain.
+double weighted_assign(struct graph *graph, int assign[MAX_NODE]) {
+    int edge[MAX_NODE][MAX_NODE];
+    double value[MAX_NODE][MAX_NODE];
+    relay_weights(graph, edge, value);
+    return hungarian(graph->AP.num_blockers, graph->AP.num_child, edge, value, assign);
 }
 
-int match(struct node *node, int t) {
-    for (int x = 0; x < node->num_parent; x++) {
-        if (node->parent[x]->traversed == 0) {
-            node->parent[x]->traversed = 1;
-            
-            if (node->parent[x]->num_child == 0 || match(node->parent[x]->child[0], t)) {
-                node->parent[x]->child[0] = node;
-                node->blocked = 2;
-                node->pp[t] = node->parent[x];
-                node->parent[x]->num_child = 1;
-                return 1;
+double weighted_matching(struct graph *graph, int t) {
+    int assign[MAX_NODE];
+    weighted_assign(graph, assign);
+    return apply_assign(graph, assign, t);
+}
+
+//Min-cost rematching: the weighted assignment with every link that moves a node off its
+//pp[t-1] parent charged that node's BEACON delay at SWITCH_RATE, so a node is rerouted only
+//when the rate gained pays for the reroute. Rebuilds all links like maximal_matching, so use
+//it after reset/find_parents; pp[t-1] survives the reset.
+#define SWITCH_RATE 0.02 //Gbps of relay gain worth one ms of delay
+
+double update_weighted(struct graph *graph, int t) {
+    int assign[MAX_NODE];
+    int edge[MAX_NODE][MAX_NODE];
+    double value[MAX_NODE][MAX_NODE];
+    relay_weights(graph, edge, value);
+    for (int x = 0; x < graph->AP.num_blockers && t > 0; x++) {
+        struct node *prev = graph->AP.blockers[x]->pp[SLOT(t-1)];
+        if (prev == NULL) {
+            continue;
+        }
+        for (int j = 0; j < graph->AP.num_child; j++) {
+            if (edge[x][j] >= 0 && graph->AP.blockers[x]->parent[edge[x][j]] != prev) {
+                value[x][j] -= SWITCH_RATE * BEACON;
             }
         }
     }
-    
-    return 0;
+    hungarian(graph->AP.num_blockers, graph->AP.num_child, edge, value, assign);
+    return apply_assign(graph, assign, t);
 }
 
-int skip_match(struct node *node, int t) {
-    for (int x = 0; x < node->num_parent; x++) {
-        if ((node->parent[x]->num_child == 1 &&
-             node->parent[x]->child[0]->checked == 1) ||
-            (node->parent[x]->checked == 1)) {
-            continue;
+//Edmonds' blossom algorithm for a maximum matching on the general graph adj over n vertices.
+//From each free vertex an alternating BFS tree is grown; an edge closing an odd cycle
+//contracts the cycle onto its base, and the first free vertex reached is flipped in along
+//the tree. O(n^3). mate[v] is v's partner or -1, returns the number of pairs.
+struct blossom {
+    int n;
+    int mate[MAX_NODE];
+    int p[MAX_NODE]; //tree parent of odd vertices
+    int base[MAX_NODE]; //base of the blossom each vertex is contracted into
+    int used[MAX_NODE]; //even vertices in the tree
+    int flower[MAX_NODE];
+    int queue[MAX_NODE];
+};
+
+int blossom_lca(struct blossom *b, int u, int v) {
+    int seen[MAX_NODE] = {0};
+    for (;;) {
+        u = b->base[u];
+        seen[u] = 1;
+        if (b->mate[u] == -1) {
+            break;
         }
-        if (node->parent[x]->traversed == 0) {
-            node->parent[x]->traversed = 1;
-            
-            if (node->parent[x]->num_child == 0 || skip_match(node->parent[x]->child[0], t)) {
-                node->parent[x]->child[0] = node;
-                node->parent[x]->num_child = 1;
-                node->pp[t] = node->parent[x];
-                node->blocked = 2;
-                return 1;
-            }
+        u = b->p[b->mate[u]];
+    }
+    for (;;) {
+        v = b->base[v];
+        if (seen[v] == 1) {
+            return v;
         }
+        v = b->p[b->mate[v]];
+    }
+}
+
+void blossom_mark(struct blossom *b, int v, int base, int child) {
+    while (b->base[v] != base) {
+        b->flower[b->base[v]] = 1;
+        b->flower[b->base[b->mate[v]]] = 1;
+        b->p[v] = child;
+        child = b->mate[v];
+        v = b->p[b->mate[v]];
     }
-    
-    return 0;
 }
 
-int all_match(struct node *node, int t) {
-    if (node->blocked == 0 && node->checked == 1) {
-        node->checked = 0;
-        node->pp[t] = NULL;
-        return 1;
+//Free vertex reached from root, or -1
+int blossom_path(struct blossom *b, int adj[MAX_NODE][MAX_NODE], int root) {
+    for (int v = 0; v < b->n; v++) {
+        b->used[v] = 0;
+        b->p[v] = -1;
+        b->base[v] = v;
     }
-    
-    for (int x = 0; x < node->num_parent; x++) {
-        if (node->parent[x]->traversed == 0) {
-            node->parent[x]->traversed = 1;
-            
-            if (node->parent[x]->num_child == 0 || all_match(node->parent[x]->child[0], t)) {
-                node->parent[x]->pp[t] = NULL;
-                node->parent[x]->child[0] = node;
-                node->parent[x]->num_child = 1;
-                node->pp[t] = node->parent[x];
-                node->blocked = 2;
-                return 1;
+    int head = 0, tail = 0;
+    b->used[root] = 1;
+    b->queue[tail++] = root;
+    while (head < tail) {
+        int v = b->queue[head++];
+        for (int to = 0; to < b->n; to++) {
+            if (adj[v][to] == 0 || b->base[v] == b->base[to] || b->mate[v] == to) {
+                continue;
+            }
+            if (to == root || (b->mate[to] != -1 && b->p[b->mate[to]] != -1)) { //odd cycle
+                int base = blossom_lca(b, v, to);
+                for (int i = 0; i < b->n; i++) {
+                    b->flower[i] = 0;
+                }
+                blossom_mark(b, v, base, to);
+                blossom_mark(b, to, base, v);
+                for (int i = 0; i < b->n; i++) {
+                    if (b->flower[b->base[i]] == 1) {
+                        b->base[i] = base;
+                        if (b->used[i] == 0) {
+                            b->used[i] = 1;
+                            b->queue[tail++] = i;
+                        }
+                    }
+                }
+            } else if (b->p[to] == -1) {
+                b->p[to] = v;
+                if (b->mate[to] == -1) {
+                    return to;
+                }
+                b->used[b->mate[to]] = 1;
+                b->queue[tail++] = b->mate[to];
             }
         }
     }
-    
-    return 0;
+    return -1;
 }
 
-int update_match(struct node *node, int t) {
-    for (int x = 0; x < node->num_parent; x++) {
-        if ((node->parent[x]->num_child == 1 &&
-            node->parent[x]->child[0]->checked == 1) ||
-            (node->parent[x]->checked == 1)) {
+int edmonds(int n, int adj[MAX_NODE][MAX_NODE], int mate[MAX_NODE]) {
+    struct blossom b;
+    int pairs = 0;
+    b.n = n;
+    for (int v = 0; v < n; v++) {
+        b.mate[v] = -1;
+    }
+    for (int v = 0; v < n; v++) {
+        if (b.mate[v] != -1) {
             continue;
         }
-        if (node->parent[x]->traversed == 0) {
-            node->parent[x]->traversed = 1;
-            
-            if (node->parent[x]->num_child == 0 || skip_match(node->parent[x]->child[0], t)) {
-                node->parent[x]->child[0] = node;
-                node->parent[x]->num_child = 1;
-                node->pp[t] = node->parent[x];
-                node->blocked = 2;
-                return 1;
-            }
+        for (int u = blossom_path(&b, adj, v); u != -1; ) {
+            int pv = b.p[u], next = b.mate[pv];
+            b.mate[u] = pv;
+            b.mate[pv] = u;
+            u = next;
         }
-    }
-    for (int x = 0; x < node->num_parent; x++) {
-        if (node->parent[x]->traversed == 0) {
-            node->parent[x]->traversed = 1;
-            
-            if (node->parent[x]->num_child == 0 || all_match(node->parent[x]->child[0], t)) {
-                node->parent[x]->pp[t] = NULL;
-                node->parent[x]->child[0] = node;
-                node->parent[x]->num_child = 1;
-                node->pp[t] = node->parent[x];
-                node->blocked = 2;
-                return 1;
-            }
+        if (b.mate[v] != -1) {
+            pairs++;
         }
     }
+    for (int v = 0; v < n; v++) {
+        mate[v] = b.mate[v];
+    }
+    return pairs;
+}
 
-    return 0;
+//Hang blocked node x under LOS node parent (its parent[y]) and, if partner >= 0, blocked node
+//partner under x
+void blossom_link(struct graph *graph, int x, int y, int partner, int t) {
+    struct node *node = graph->AP.blockers[x];
+    struct node *parent = node->parent[y];
+    parent->child[0] = node;
+    parent->num_child = 1;
+    node->pp[SLOT(t)] = parent;
+    node->idx = y;
+    node->blocked = 2;
+    if (partner >= 0) {
+        node->child[0] = graph->AP.blockers[partner];
+        node->num_child = 1;
+        graph->AP.blockers[partner]->pp[SLOT(t)] = node;
+        graph->AP.blockers[partner]->blocked = 2;
+    }
 }
 
-int update_match_stable(struct node *node, int t) {
-    for (int x = 0; x < node->num_parent; x++) {
-        if ((node->parent[x]->num_child == 1 &&
-             node->parent[x]->child[0]->checked == 1) ||
-            (node->parent[x]->checked == 1)) {
+//Relaying over the general visibility graph of blocked nodes. Two blocked nodes that see
+//each other may pair up if either has a LOS parent, so one LOS node reaches both through a
+//two-hop chain; these pairs form an odd-cycle graph and are found by edmonds(). Pairs and
+//unpaired nodes are then assigned to LOS nodes (hungarian, a pair counting twice), the
+//nodes left over are matched directly (match()), chain tails with a free LOS parent of
+//their own are moved onto it, and the rest may still hang under a one-hop relay with no
+//child. Returns the number of nodes left unreached.
+double blossom_matching(struct graph *graph, int t) {
+    int n = graph->AP.num_blockers;
+    int m = graph->AP.num_child;
+    int adj[MAX_NODE][MAX_NODE];
+    int mate[MAX_NODE];
+    for (int x = 0; x < n; x++) {
+        adj[x][x] = 0;
+        for (int y = x + 1; y < n; y++) {
+            struct node *a = graph->AP.blockers[x], *b = graph->AP.blockers[y];
+            adj[x][y] = adj[y][x] = (a->num_parent > 0 || b->num_parent > 0) &&
+                                    check_blockage_node(a, b, graph->coordinate, 0) == 0;
+        }
+    }
+    edmonds(n, adj, mate);
+    
+    //Units: a pair (x, mate[x]) with x < mate[x], or an unpaired x. For each LOS node the unit
+    //can use, inner/hop give the node it links to and that node's parent index.
+    int col[MAX_NODE];
+    int unit[MAX_NODE], num = 0;
+    int edge[MAX_NODE][MAX_NODE], inner[MAX_NODE][MAX_NODE], hop[MAX_NODE][MAX_NODE];
+    double value[MAX_NODE][MAX_NODE];
+    for (int j = 0; j < m; j++) {
+        col[graph->AP.child[j]->id] = j;
+    }
+    for (int x = 0; x < n; x++) {
+        if (mate[x] != -1 && mate[x] < x) {
             continue;
         }
-        if (node->parent[x]->traversed == 0) {
-            node->parent[x]->traversed = 1;
-            
-            if (node->parent[x]->num_child == 0 || skip_match(node->parent[x]->child[0], t)) {
-                node->parent[x]->child[0] = node;
-                node->parent[x]->num_child = 1;
-                node->pp[t] = node->parent[x];
-                node->blocked = 2;
-                return 1;
+        for (int j = 0; j < m; j++) {
+            edge[num][j] = -1;
+            value[num][j] = 0;
+        }
+        for (int k = 0; k < 2; k++) {
+            int v = k == 0 ? x : mate[x];
+            if (v == -1) {
+                continue;
+            }
+            struct node *node = graph->AP.blockers[v];
+            for (int y = 0; y < node->num_parent; y++) {
+                int j = col[node->parent[y]->id];
+                if (edge[num][j] == -1 || node->distance[y] < graph->AP.blockers[inner[num][j]]->distance[hop[num][j]]) {
+                    edge[num][j] = j;
+                    value[num][j] = mate[x] == -1 ? 1 : 2;
+                    inner[num][j] = v;
+                    hop[num][j] = y;
+                }
             }
         }
+        unit[num++] = x;
+    }
+    int assign[MAX_NODE];
+    hungarian(num, m, edge, value, assign);
+    for (int u = 0; u < num; u++) {
+        if (assign[u] >= 0) {
+            int x = inner[u][assign[u]];
+            blossom_link(graph, x, hop[u][assign[u]], x == unit[u] ? mate[unit[u]] : unit[u], t);
+        }
     }
     
-    int found = 0, y = 0;
-    for (int z = 0; z < node->num_parent; z++) { //possible to add threshold on distance
-        if (node->parent[z]->checked == 1) {
-            if (found == 0) {
-                found = 1;
-                y = z;
-            } else if (node->parent[z]->stability < node->parent[y]->stability) {
-                y = z;
-            }
-        } else if (node->parent[z]->num_child == 1 &&
-                   node->parent[z]->child[0]->blocked == 0) {
-            if (found == 0) {
-                found = 1;
-                y = z;
-            } else if (node->parent[z]->child[0]->stability < node->parent[y]->stability) {
-                y = z;
+    double z = 0;
+    for (int x = 0; x < n; x++) {
+        if (graph->AP.blockers[x]->blocked != 2) {
+            match(graph, graph->AP.blockers[x], t);
+            clear_traversed(graph);
+        }
+    }
+    for (int x = 0; x < n; x++) { //chain tails back onto a free LOS parent
+        struct node *node = graph->AP.blockers[x];
+        if (node->blocked != 2 || node->pp[SLOT(t)]->blocked == 0) {
+            continue;
+        }
+        for (int y = 0; y < node->num_parent; y++) {
+            if (node->parent[y]->num_child == 0) {
+                node->pp[SLOT(t)]->child[0] = NULL;
+                node->pp[SLOT(t)]->num_child = 0;
+                blossom_link(graph, x, y, -1, t);
+                break;
             }
         }
     }
-    
-    if (found == 1) {
-        if (node->parent[y]->num_child == 1 &&
-            node->parent[y]->child[0]->blocked == 0) {
-            //Modify child
-            node->parent[y]->child[0]->checked = 0;
-            node->parent[y]->child[0]->pp[t] = NULL;
-        } else if (node->parent[y]->checked == 1) {
-            //Modify Parent
-            node->parent[y]->pp[t]->num_child = 0;
-            node->parent[y]->pp[t]->child[0] = NULL;
-            
-            //Modify Child
-            node->parent[y]->pp[t] = NULL;
-            node->parent[y]->checked = 0;
-            node->parent[y]->num_child = 1;
+    for (int x = 0; x < n; x++) {
+        struct node *node = graph->AP.blockers[x];
+        if (node->blocked == 2) {
+            continue;
+        }
+        for (int y = 0; y < n; y++) {
+            struct node *relay = graph->AP.blockers[y];
+            if (adj[x][y] == 1 && relay->blocked == 2 && relay->num_child == 0 &&
+                relay->pp[SLOT(t)]->blocked == 0) {
+                relay->child[0] = node;
+                relay->num_child = 1;
+                node->pp[SLOT(t)] = relay;
+                node->blocked = 2;
+                break;
+            }
         }
-        node->parent[y]->child[0] = node;
-        node->blocked = 2;
-        node->pp[t] = node->parent[y];
-        return 1;
     }
     
-    return 0;
-}
-
-void reset_traversed(unsigned int pop, struct node *child[MAX_NODE]) {
-    for (unsigned int i = 0; i < pop; i++) {
-        child[i]->traversed = 0;
-    }
-}
-
-double maximal_matching(struct graph *graph, int t) {
-    double z = 0;
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        if (match(graph->AP.blockers[x], t) == 1) {
+    for (int x = 0; x < n; x++) {
+        if (graph->AP.blockers[x]->blocked == 2) {
             z++;
         } else {
             graph->AP.blockers[x]->reachability++;
         }
-        reset_traversed(graph->AP.num_child, graph->AP.child);
     }
     
-    return (double) graph->AP.num_blockers - z;
+    return (double) n - z;
 }
 
-double update_perfect(struct graph *graph, int t) {
-    double z = 0;
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        if (graph->AP.blockers[x]->checked == 0) {
-            if (update_match(graph->AP.blockers[x], t) == 1) {
-                z++;
-                graph->AP.blockers[x]->blocked = 2;
-            } else {
-                graph->AP.blockers[x]->reachability++;
+//Auction assignment over the same weights as weighted_assign. The problem is made square
+//with an "unmatched" slot per blocked node and a slack bidder per LOS node, which takes
+//its LOS node or any free slot for 0, so every phase ends in a full assignment and prices
+//stay valid across phases. Each round every unassigned bidder bids for its best
+//object at once (Jacobi bidding), which is the part run in parallel when built with
+//-fopenmp. The bid step starts at AUCTION_EPS_START and shrinks by AUCTION_SCALE per phase
+//down to AUCTION_EPS; the result is within (num_blockers + num_child) * AUCTION_EPS of the
+//optimum, so AUCTION_EPS trades speed for rate.
+#define AUCTION_EPS 0.01 //Gbps
+#define AUCTION_EPS_START 8.0
+#define AUCTION_SCALE 4.0
+#define AUCTION_PAR 16 //fewest bidders worth spreading over threads
+
+double auction_assign(struct graph *graph, int assign[MAX_NODE]) {
+    int n = graph->AP.num_blockers;
+    int m = graph->AP.num_child;
+    int size = n + m;
+    int edge[MAX_NODE][MAX_NODE];
+    double value[MAX_NODE][MAX_NODE];
+    double price[2 * MAX_NODE] = {0};
+    double bid[2 * MAX_NODE];
+    int target[2 * MAX_NODE];
+    int object[2 * MAX_NODE];
+    int owner[2 * MAX_NODE];
+    relay_weights(graph, edge, value);
+    
+    for (double eps = AUCTION_EPS_START; ; eps /= AUCTION_SCALE) {
+        if (eps < AUCTION_EPS) {
+            eps = AUCTION_EPS;
+        }
+        for (int i = 0; i < size; i++) {
+            object[i] = -1;
+            owner[i] = -1;
+        }
+        int left = size;
+        while (left > 0) {
+            //Bidding: each bidder only writes its own target/bid
+#ifdef _OPENMP
+#pragma omp parallel for if (size >= AUCTION_PAR)
+#endif
+            for (int i = 0; i < size; i++) {
+                target[i] = -1;
+                if (object[i] != -1) {
+                    continue;
+                }
+                double best = -INFINITY, second = -INFINITY;
+                for (int j = 0; j < size; j++) {
+                    double v;
+                    if (i < n && j < m) {
+                        if (edge[i][j] < 0) {
+                            continue;
+                        }
+                        v = value[i][j] - price[j];
+                    } else if ((i < n && j - m == i) || (i >= n && (j >= m || j == i - n))) {
+                        v = -price[j];
+                    } else {
+                        continue;
+                    }
+                    if (v > best) {
+                        second = best;
+                        best = v;
+                        target[i] = j;
+                    } else if (v > second) {
+                        second = v;
+                    }
+                }
+                if (second == -INFINITY) {
+                    second = best;
+                }
+                bid[i] = price[target[i]] + best - second + eps;
             }
-            reset_traversed(graph->AP.num_child, graph->AP.child);
-        } else {
-            z++;
-            graph->AP.blockers[x]->blocked = 2;
+            
+            //Assignment: the highest bid on each object wins and evicts its owner
+            for (int i = 0; i < size; i++) {
+                int j = target[i];
+                if (j >= 0 && bid[i] > price[j]) {
+                    if (owner[j] >= 0) {
+                        object[owner[j]] = -1;
+                    } else {
+                        left--;
+                    }
+                    price[j] = bid[i];
+                    owner[j] = i;
+                    object[i] = j;
+                }
+            }
+        }
+        if (eps == AUCTION_EPS) {
+            break;
         }
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
+    double gain = 0;
+    for (int x = 0; x < n; x++) {
+        assign[x] = -1;
+        if (object[x] < m) {
+            gain += value[x][object[x]] - WEIGHT_BASE;
+            assign[x] = edge[x][object[x]];
+        }
     }
-    
-    return (double) graph->AP.num_blockers - z;
+    return gain;
 }
 
-double update_perfect_stable(struct graph *graph, int t) {
-    double z = 0;
-    for (int x = 0; x < graph->AP.num_blockers; x++) {
-        if (graph->AP.blockers[x]->checked == 0) {
-            if (update_match_stable(graph->AP.blockers[x], t) == 1) {
-                z++;
-                graph->AP.blockers[x]->blocked = 2;
-            } else {
-                graph->AP.blockers[x]->reachability++;
-            }
-            reset_traversed(graph->AP.num_child, graph->AP.child);
-        } else {
-            z++;
-            graph->AP.blockers[x]->blocked = 2;
+double auction_matching(struct graph *graph, int t) {
+    int assign[MAX_NODE];
+    auction_assign(graph, assign);
+    return apply_assign(graph, assign, t);
+}
+
+//Relay gain (Gbps) the weighted assignment would reach minus that of the current links.
+//Call after matching and before update_capacity_delay; negative when the current links
+//leave nodes unmatched for a higher rate.
+double weighted_gap(struct graph *graph) {
+    int assign[MAX_NODE];
+    double gain = 0;
+    for (int x = 0; x < graph->AP.num_child; x++) {
+        struct node *parent = graph->AP.child[x];
+        if (parent->num_child == 1 && parent->child[0]->blocked != 0) {
+            gain += relay_gain(parent, parent->child[0]);
         }
     }
-    
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-    }
-    
-    return (double) graph->AP.num_blockers - z;
+    return weighted_assign(graph, assign) - gain;
 }
 
 //used only for depth 2
@@ -4479,10 +4482,18 @@ double get_stability(struct graph *graph) {
     return ret;
 }
 
+//Drop the parent recorded two timesteps ago so slot t starts empty
+void begin_timestep(struct graph *graph, int t) {
+    graph->AP.pp[SLOT(t)] = NULL;
+    for (int x = 0; x < graph->population; x++) {
+        graph->people[x].pp[SLOT(t)] = NULL;
+    }
+}
+
 double calc_stability(struct graph *graph, int t) {
     double ret = 0;
     for (int x = 0; x < graph->population; x++) {
-        if (graph->people[x].pp[t] != graph->people[x].pp[t-1]) {
+        if (graph->people[x].pp[SLOT(t)] != graph->people[x].pp[SLOT(t-1)]) {
             graph->people[x].stability++;
         }
         ret += graph->people[x].stability;
@@ -4530,11 +4541,11 @@ double get_reach(struct graph *graph) {
 
 void update_capacity_delay_stationary(struct graph *graph, int t) {
     for (int x = 0; x < graph->population; x++) {
-        if (graph->people[x].checked == 1) {
+        if (FLAG(graph->people[x].checked, graph->epoch_checked) == 1) {
             continue;
         }
         if (graph->people[x].num_child > 0) {
-            graph->people[x].child[0]->checked = 1;
+            graph->people[x].child[0]->checked = STAMP(1, graph->epoch_checked);
             graph->people[x].delay = RENDER + NET + BEAM + 2 * IMAGE * 1000 / graph->people[x].capacity;
             graph->people[x].child[0]->capacity = calc_capacity(&graph->people[x], graph->people[x].child[0]);
             graph->people[x].child[0]->delay = graph->people[x].delay + BEAM;
@@ -4545,7 +4556,7 @@ void update_capacity_delay_stationary(struct graph *graph, int t) {
             } else {
                 graph->people[x].child[0]->capacity = graph->people[x].capacity;
             }
-        } else if (graph->people[x].blocked == 0 && graph->people[x].pp[t] == NULL) {
+        } else if (graph->people[x].blocked == 0 && graph->people[x].pp[SLOT(t)] == NULL) {
             graph->people[x].delay = RENDER + NET + BEAM + IMAGE * 1000 / graph->people[x].capacity;
             if (graph->people[x].capacity > LIMIT) {
                 graph->people[x].capacity = LIMIT;
@@ -4553,29 +4564,76 @@ void update_capacity_delay_stationary(struct graph *graph, int t) {
         }
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
+    clear_checked(graph);
+}
+
+//One more hop of a relay chain: relay already has its rate and delay from its own parent and
+//forwards its child's frame over a second beam, sharing its link like a LOS relay does
+void relay_hop(struct graph *graph, struct node *relay, int t) {
+    struct node *child = relay->child[0];
+    child->checked = STAMP(1, graph->epoch_checked);
+    child->capacity = calc_capacity(relay, child);
+    child->delay = relay->delay + BEAM + IMAGE * 1000.0 / relay->capacity;
+    if (t > 0 && child->pp[SLOT(t)] != child->pp[SLOT(t-1)]) {
+        child->delay += BEACON;
+    }
+    relay->capacity /= 2;
+    if (child->capacity > relay->capacity) {
+        child->capacity = relay->capacity;
+    }
+}
+
+//Airtime split for a LOS node relaying for several children: its AP link is shared
+//equally by itself and each child, and it beams to the children in turn
+void relay_split(struct graph *graph, struct node *parent, int t) {
+    double share = parent->num_child + 1;
+    parent->delay = RENDER + NET + BEAM + share * IMAGE * 1000.0 / parent->capacity;
+    if (t > 0 && parent->pp[SLOT(t)] != parent->pp[SLOT(t-1)]) {
+        parent->delay += BEACON;
+    }
+    parent->capacity /= share;
+    if (parent->capacity > LIMIT) {
+        parent->capacity = LIMIT;
+    }
+    for (unsigned int y = 0; y < parent->num_child; y++) {
+        struct node *child = parent->child[y];
+        child->checked = STAMP(1, graph->epoch_checked);
+        child->capacity = calc_capacity(parent, child);
+        child->delay = parent->delay;
+        if (t > 0 && child->pp[SLOT(t)] != child->pp[SLOT(t-1)]) {
+            child->delay += BEACON;
+        }
+        if (child->capacity > parent->capacity) {
+            child->capacity = parent->capacity;
+        } else {
+            child->delay += IMAGE * 1000.0 / parent->capacity * ((parent->capacity - child->capacity) / parent->capacity);
+        }
     }
 }
 
 void update_capacity_delay(struct graph *graph, int t) {
     for (int x = 0; x < graph->population; x++) {
-        if (graph->people[x].checked == 1) {
+        if (FLAG(graph->people[x].checked, graph->epoch_checked) == 1) {
             continue;
         }
         
-        if (graph->people[x].num_child > 0) {
+        if (graph->people[x].num_child > 1 && graph->people[x].blocked == 0) {
+            relay_split(graph, &graph->people[x], t);
+        } else if (graph->people[x].num_child > 0) {
+            if (graph->people[x].blocked != 0 && graph->people[x].pp[SLOT(t)] != NULL) {
+                continue; //inner relay of a chain, done from the chain's LOS end
+            }
             //fprintf(stderr, "graph->people[x].num_child: %d\tgraph->people[x].child[0]: %p\n",  graph->people[x].num_child, graph->people[x].child[0]);
-            graph->people[x].child[0]->checked = 1;
+            graph->people[x].child[0]->checked = STAMP(1, graph->epoch_checked);
             graph->people[x].child[0]->capacity = calc_capacity(&graph->people[x], graph->people[x].child[0]);
             
             if (t > 0) {
-                if (graph->people[x].pp[t] != graph->people[x].pp[t-1]) {
+                if (graph->people[x].pp[SLOT(t)] != graph->people[x].pp[SLOT(t-1)]) {
                     graph->people[x].delay = RENDER + NET + BEAM + BEACON + 2 * IMAGE * 1000 / graph->people[x].capacity;
                     graph->people[x].child[0]->delay = graph->people[x].delay;
                 } else {
                     graph->people[x].delay = RENDER + NET + BEAM + 2 * IMAGE * 1000 / graph->people[x].capacity;
-                    if (graph->people[x].child[0]->pp[t] != graph->people[x].child[0]->pp[t-1]) {
+                    if (graph->people[x].child[0]->pp[SLOT(t)] != graph->people[x].child[0]->pp[SLOT(t-1)]) {
                         graph->people[x].child[0]->delay = graph->people[x].delay + BEACON;
                     } else {
                         graph->people[x].child[0]->delay = graph->people[x].delay;
@@ -4597,9 +4655,13 @@ void update_capacity_delay(struct graph *graph, int t) {
                 graph->people[x].child[0]->delay += (IMAGE  / graph->people[x].capacity * 1000) *
                 ((graph->people[x].capacity - graph->people[x].child[0]->capacity)/graph->people[x].capacity);
             }
-        } else if (graph->people[x].blocked == 0 && graph->people[x].pp[t] == NULL) {
+            //blocked relays only, as built by relay_routing and blossom_matching
+            for (struct node *relay = graph->people[x].child[0]; relay->blocked != 0 && relay->num_child > 0; relay = relay->child[0]) {
+                relay_hop(graph, relay, t);
+            }
+        } else if (graph->people[x].blocked == 0 && graph->people[x].pp[SLOT(t)] == NULL) {
             if (t > 0) {
-                if (graph->people[x].pp[t-1] != NULL) {
+                if (graph->people[x].pp[SLOT(t-1)] != NULL) {
                     graph->people[x].delay = RENDER + NET + BEAM + BEACON + IMAGE * 1000 / graph->people[x].capacity;
                 } else {
                     graph->people[x].delay = RENDER + NET + BEAM + IMAGE * 1000 / graph->people[x].capacity;
@@ -4610,14 +4672,12 @@ void update_capacity_delay(struct graph *graph, int t) {
             if (graph->people[x].capacity > LIMIT) {
                 graph->people[x].capacity = LIMIT;
             }
-        } else if (graph->people[x].blocked == 1 && graph->people[x].pp[t] == NULL) {
+        } else if (graph->people[x].blocked == 1 && graph->people[x].pp[SLOT(t)] == NULL) {
             graph->people[x].delay = BLOCK;
         }
     }
     
-    for (int x = 0; x < graph->population; x++) {
-        graph->people[x].checked = 0;
-    }
+    clear_checked(graph);
 }
 
 double get_capacity(struct graph *graph) {
@@ -4628,6 +4688,21 @@ double get_capacity(struct graph *graph) {
     return ret/graph->population;
 }
 
+//Adds each served node's rate and count to the AP its chain ends at, LOS nodes to their own
+void add_ap_stats(struct graph *graph, int t, double capacity[MAX_AP], double served[MAX_AP]) {
+    for (int x = 0; x < graph->population; x++) {
+        struct node *root = &graph->people[x];
+        for (int hop = 0; root != NULL && root->blocked != 0 && hop < MAX_NODE; hop++) {
+            root = root->pp[SLOT(t)];
+        }
+        if (root == NULL || root->blocked != 0) {
+            continue;
+        }
+        capacity[root->ap] += graph->people[x].capacity;
+        served[root->ap]++;
+    }
+}
+
 double get_delay(struct graph *graph) {
     double ret = 0;
     double count = 0;
@@ -4655,18 +4730,279 @@ void save_stat(struct graph *graph, struct stat *stat) {
     }
 }
 
+void init_series(struct series *series, int timestep) {
+    memset(series->sum, 0, sizeof(series->sum));
+    series->span = (timestep + WINDOW - 1) / WINDOW;
+    series->len = timestep;
+}
 
+void add_series(struct series *series, int t, double value) {
+    series->sum[t / series->span] += value;
+}
 
+//Prints one average per point: total / timesteps in point / div / unit
+void write_series(FILE *out, struct series *series, double div, double unit) {
+    for (int t = 0; t < series->len; t += series->span) {
+        int n = series->len - t < series->span ? series->len - t : series->span;
+        fprintf(out, "%.4f,", series->sum[t / series->span] / n / div / unit);
+    }
+}
 
+void init_trace(struct trace *trace) {
+    trace->steps = 0;
+}
 
+//Call after matching at step t, before the next begin_timestep
+void record_step(struct trace *trace, struct graph *graph, int t) {
+    if (trace->steps == TRACE_STEPS) {
+        return;
+    }
+    int s = trace->steps++;
+    trace->num[s] = graph->AP.num_blockers;
+    trace->need[s] = 0;
+    for (int x = 0; x < graph->AP.num_blockers; x++) {
+        struct node *node = graph->AP.blockers[x];
+        struct node *parent = node->pp[SLOT(t)];
+        trace->id[s][x] = node->id;
+        trace->cand[s][x] = node->parents;
+        trace->pp[s][x] = parent == NULL || parent == &graph->AP ? -1 : parent->id;
+        if (trace->pp[s][x] >= 0 && nodeset_has(&node->parents, trace->pp[s][x])) {
+            trace->need[s]++;
+        }
+    }
+}
 
+//Times a blocked node's parent differs from the one it had the step before (-1 while LOS)
+int trace_reroutes(struct trace *trace) {
+    int prev[MAX_NODE], cur[MAX_NODE], ret = 0;
+    for (int i = 0; i < MAX_NODE; i++) {
+        prev[i] = -1;
+    }
+    for (int s = 0; s < trace->steps; s++) {
+        for (int i = 0; i < MAX_NODE; i++) {
+            cur[i] = -1;
+        }
+        for (int x = 0; x < trace->num[s]; x++) {
+            cur[trace->id[s][x]] = trace->pp[s][x];
+            if (s > 0 && trace->pp[s][x] != prev[trace->id[s][x]]) {
+                ret++;
+            }
+        }
+        memcpy(prev, cur, sizeof(prev));
+    }
+    return ret;
+}
 
+//Branch-and-bound over the per-step matchings of a trace: fewest reroutes (as counted by
+//matcher_reroutes, links to LOS parents only) with each step linking at least as many
+//blocked nodes to LOS parents as the matcher did.
+//Cost-to-go from step t depends only on the parents the step's blocked nodes had at t-1,
+//and only on those they can still use, which keys the memo; entries are exact or lower
+//bounds found under a tighter budget.
+#define BNB_MEMO (1 << 15)
+#define BNB_NODES 4000000 //search nodes before giving up on a trace
 
+struct memo {
+    int t; //-1 if empty
+    int value;
+    int exact;
+    signed char key[MAX_NODE];
+};
 
+struct bnb {
+    struct trace *trace;
+    int lb[TRACE_STEPS + 1]; //fewest reroutes from step s to the end
+    long nodes;
+    struct memo *memo;
+};
 
+int bnb_step(struct bnb *bnb, int t, int prev[MAX_NODE], int budget);
 
+//Choose a parent for the j-th blocked node of step t and recurse; returns min(best, any
+//cheaper completion). Keeping the old parent is tried first so good bounds come early.
+int bnb_assign(struct bnb *bnb, int t, int j, int prev[MAX_NODE], int cur[MAX_NODE],
+               struct nodeset *used, int matched, int cost, int best) {
+    struct trace *trace = bnb->trace;
+    if (matched + trace->num[t] - j < trace->need[t] || ++bnb->nodes > BNB_NODES) {
+        return best;
+    }
+    
+    //Still to pay this step: nodes whose old parent is gone change whatever they pick, and
+    //links beyond those that can be kept for free all change
+    int change = t > 0 ? 1 : 0;
+    int lost = 0, keep = 0;
+    for (int k = j; k < trace->num[t] && change == 1; k++) {
+        int old = prev[trace->id[t][k]];
+        if (old >= 0) {
+            if (nodeset_has(&trace->cand[t][k], old) && nodeset_has(used, old) == 0) {
+                keep++;
+            } else {
+                lost++;
+            }
+        }
+    }
+    int extra = trace->need[t] - matched - keep - lost;
+    if (cost + change * (lost + (extra > 0 ? extra : 0)) + bnb->lb[t + 1] >= best) {
+        return best;
+    }
+    if (j == trace->num[t]) {
+        int v = cost + bnb_step(bnb, t + 1, cur, best - cost);
+        return v < best ? v : best;
+    }
+    
+    int id = trace->id[t][j];
+    int old = prev[id];
+    struct nodeset *cand = &trace->cand[t][j];
+    if (old >= 0 && nodeset_has(cand, old) && nodeset_has(used, old) == 0) {
+        cur[id] = old;
+        nodeset_add(used, old);
+        best = bnb_assign(bnb, t, j + 1, prev, cur, used, matched + 1, cost, best);
+        nodeset_remove(used, old);
+    }
+    if (old == -1) {
+        cur[id] = -1;
+        best = bnb_assign(bnb, t, j + 1, prev, cur, used, matched, cost, best);
+    }
+    for (int q = nodeset_first(cand); q != -1; q = nodeset_next(cand, q + 1)) {
+        if (q != old && nodeset_has(used, q) == 0) {
+            cur[id] = q;
+            nodeset_add(used, q);
+            best = bnb_assign(bnb, t, j + 1, prev, cur, used, matched + 1, cost + change, best);
+            nodeset_remove(used, q);
+        }
+    }
+    if (old != -1) {
+        cur[id] = -1;
+        best = bnb_assign(bnb, t, j + 1, prev, cur, used, matched, cost + change, best);
+    }
+    cur[id] = -1;
+    return best;
+}
 
+//Fewest reroutes from step t on given the parents at t-1; exact if below budget,
+//otherwise some lower bound >= budget
+int bnb_step(struct bnb *bnb, int t, int prev[MAX_NODE], int budget) {
+    struct trace *trace = bnb->trace;
+    if (t == trace->steps) {
+        return 0;
+    }
+    if (bnb->lb[t] >= budget) {
+        return bnb->lb[t];
+    }
+    
+    signed char key[MAX_NODE];
+    unsigned int h = t * 2654435761u;
+    for (int j = 0; j < trace->num[t]; j++) {
+        int old = prev[trace->id[t][j]];
+        key[j] = (signed char) (old >= 0 && nodeset_has(&trace->cand[t][j], old) == 0 ? MAX_NODE : old); //all lost parents cost the same
+        h = (h ^ (unsigned char) key[j]) * 16777619u;
+    }
+    struct memo *entry = &bnb->memo[h & (BNB_MEMO - 1)];
+    if (entry->t == t && memcmp(entry->key, key, trace->num[t]) == 0 &&
+        (entry->exact == 1 || entry->value >= budget)) {
+        return entry->value;
+    }
+    int cur[MAX_NODE];
+    struct nodeset used;
+    for (int i = 0; i < MAX_NODE; i++) {
+        cur[i] = -1;
+    }
+    nodeset_clear(&used);
+    int value = bnb_assign(bnb, t, 0, prev, cur, &used, 0, 0, budget);
+    
+    entry->t = t;
+    entry->value = value;
+    entry->exact = value < budget;
+    memcpy(entry->key, key, trace->num[t]);
+    return value;
+}
 
+//Reroutes of the matcher's own schedule with links outside the LOS parents dropped, the
+//measure optimal_reroutes minimizes. It is a feasible solution and so the first bound for
+//the search; -1 if it is not (a LOS parent shared by two blocked nodes).
+int matcher_reroutes(struct trace *trace) {
+    int prev[MAX_NODE], cur[MAX_NODE], ret = 0;
+    for (int i = 0; i < MAX_NODE; i++) {
+        prev[i] = -1;
+    }
+    for (int s = 0; s < trace->steps; s++) {
+        struct nodeset used;
+        nodeset_clear(&used);
+        for (int i = 0; i < MAX_NODE; i++) {
+            cur[i] = -1;
+        }
+        for (int x = 0; x < trace->num[s]; x++) {
+            int p = trace->pp[s][x];
+            if (p >= 0 && nodeset_has(&trace->cand[s][x], p)) {
+                if (nodeset_has(&used, p)) { //shared parent, not a matching
+                    return -1;
+                }
+                nodeset_add(&used, p);
+                cur[trace->id[s][x]] = p;
+            }
+            if (s > 0 && cur[trace->id[s][x]] != prev[trace->id[s][x]]) {
+                ret++;
+            }
+        }
+        memcpy(prev, cur, sizeof(prev));
+    }
+    return ret;
+}
 
+//Exact fewest reroutes for a trace, -1 if the search ran out of BNB_NODES
+int optimal_reroutes(struct trace *trace) {
+    struct bnb bnb;
+    bnb.trace = trace;
+    bnb.nodes = 0;
+    bnb.memo = malloc(sizeof(struct memo) * BNB_MEMO);
+    if (bnb.memo == NULL) {
+        fprintf(stderr, "Cannot allocate branch-and-bound memo\n");
+        return -1;
+    }
+    for (int i = 0; i < BNB_MEMO; i++) {
+        bnb.memo[i].t = -1;
+    }
+    
+    //A step needing more links than it has nodes carried over from the step before must
+    //link that many newly blocked nodes, each of which had no parent
+    bnb.lb[trace->steps] = 0;
+    for (int s = trace->steps - 1; s >= 0; s--) {
+        int forced = 0;
+        if (s > 0) {
+            int kept = 0;
+            for (int x = 0; x < trace->num[s]; x++) {
+                for (int y = 0; y < trace->num[s - 1]; y++) {
+                    if (trace->id[s - 1][y] == trace->id[s][x]) {
+                        kept++;
+                        break;
+                    }
+                }
+            }
+            forced = trace->need[s] > kept ? trace->need[s] - kept : 0;
+        }
+        bnb.lb[s] = bnb.lb[s + 1] + forced;
+    }
+    
+    int prev[MAX_NODE];
+    for (int i = 0; i < MAX_NODE; i++) {
+        prev[i] = -1;
+    }
+    int budget = matcher_reroutes(trace);
+    budget = budget < 0 ? trace->steps * MAX_NODE + 1 : budget + 1;
+    int ret = bnb_step(&bnb, 0, prev, budget);
+    if (bnb.nodes > BNB_NODES) {
+        ret = -1;
+    }
+    free(bnb.memo);
+    return ret;
+}
 
-
+//opt[x] = optimal_reroutes(&trace[x]), trials spread over threads when built with -fopenmp
+void solve_traces(struct trace *trace, int n, int *opt) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int x = 0; x < n; x++) {
+        opt[x] = optimal_reroutes(&trace[x]);
+    }
+}
@@ -10,16 +10,27 @@
 #define sim_h
 
 #include <stdio.h>
-#define MAXT 200  //max timesteps
+#define PP_SLOTS 2 //parent history per node: current and previous timestep
+#define SLOT(t) ((t) & (PP_SLOTS - 1))
+#define WINDOW 200 //max points kept per statistics series
+#define TRACE_STEPS 50 //timesteps recorded per trial for the exact rerouting baseline
 #define WIDTH 50
 #define LENGTH 50
 #define MAX_NODE 32
 #define FAT 0.25
 #define MIN_HEIGHT 1.2
 #define MAX_GROUP 10
+#define MAX_AP 8 //access points per hall: AP plus mirrors
+#define SET_WORDS ((MAX_NODE + 63) / 64)
+
+//Bitset over person ids (index into graph->people)
+struct nodeset {
+    unsigned long long word[SET_WORDS];
+};
 
 struct node {
     int person;
+    int id;
     int blocked;
     int traversed;
     int checked;
@@ -43,7 +54,10 @@ struct node {
     struct node *blockers[MAX_NODE];
     unsigned int num_parent;
     struct node *parent[MAX_NODE];
-    struct node *pp[MAXT];
+    struct nodeset parents;
+    struct node *pp[PP_SLOTS];
+    int ap; //AP a LOS node is associated with (get_ap)
+    unsigned int aps; //bit k set when the node has LOS to AP k
 };
 
 struct graph {
@@ -52,8 +66,13 @@ struct graph {
     unsigned int population;
     struct node *people;
     struct node *rr[MAX_NODE];
-    unsigned int num_mirrors;
+    unsigned int num_mirrors; //APs besides AP, mirrors[k - 1] is AP k
     struct node *mirrors;
+    unsigned int epoch_checked;
+    unsigned int epoch_marked;
+    unsigned int epoch_traversed;
+    struct nodeset los; //line of sight nodes (AP.child)
+    struct nodeset free; //LOS nodes without a child
 };
 
 struct stat {
@@ -61,8 +80,35 @@ struct stat {
     int trials;
 };
 
+//Per-timestep totals folded into at most WINDOW points of span timesteps each
+struct series {
+    double sum[WINDOW];
+    int span;
+    int len;
+};
+
+//Relay candidates and the matcher's choices over the first TRACE_STEPS timesteps of a
+//trial, so its rerouting can be compared offline with the exact optimum
+struct trace {
+    int steps;
+    int num[TRACE_STEPS]; //blocked nodes per step
+    int need[TRACE_STEPS]; //how many of them the matcher linked to a LOS parent
+    int id[TRACE_STEPS][MAX_NODE];
+    int pp[TRACE_STEPS][MAX_NODE]; //parent id the matcher picked, -1 if none
+    struct nodeset cand[TRACE_STEPS][MAX_NODE]; //LOS parents
+};
+
+void seed_shadow(unsigned long long key);
+void fill_shadow(double *out, int n);
 struct graph *generate_graph_unif(int width, int length, int ap_x, int ap_y, int population, double ap_height);
 struct graph *generate_graph_group(int width, int length, int ap_x, int ap_y, double ap_height, int population, int group_size);
+struct graph *alloc_graph(int population);
+void clear_graph(struct graph *graph);
+struct graph *regenerate_graph_group(struct graph *graph, int width, int length, int ap_x, int ap_y, double ap_height, int group_size);
+int alloc_mirrors(struct graph *graph, int num_ap);
+void place_mirrors(int width, int length, struct graph *graph);
+struct node *get_ap(struct graph *graph, int k);
+int ap_cell(struct graph *graph, double x, double y);
 void fill_group(struct graph *graph, int group_size);
 void sort_group_distance(struct graph *graph);
 void sort_group_capacity(struct graph *graph);
@@ -71,8 +117,12 @@ void visualize_graph(int width, int length, struct graph *graph);
 void visualize_stability(int width, int length, struct graph *graph);
 void visualize_reachability(int width, int length, struct graph *graph);
 void destroy_resources(struct graph *graph);
+struct graph *copy_graph(struct graph *dst, struct graph *src);
+struct graph *clone_graph(struct graph *graph);
 void sort_pointer(struct graph *graph, struct node* node[MAX_NODE]);
 
+void find_aps(struct graph *graph);
+int sees_ap(struct graph *graph, struct node *node);
 double check_blockage(struct graph *graph);
 double update_blockage_d2(struct graph *graph);
 double update_blockage(struct graph *graph);
@@ -82,6 +132,7 @@ void find_distance(struct graph *graph);
 void sort_parent_distance(struct graph *graph);
 void sort_parent_height(struct graph *graph);
 void sort_parent_capacity(struct graph *graph);
+void sort_parent_predicted(int width, int length, struct graph *graph, struct graph *scratch);
 void sort_group_parent_capacity(struct graph *graph);
 void update_parents(struct graph *graph, int t);
 void update_parents_depth2(struct graph *graph);
@@ -95,6 +146,10 @@ double group_matching(struct graph *graph, int t);
 double group_matching_fair(struct graph *graph, int t);
 double stable_matching(struct graph *graph, int t);
 double stable_matching_fair(struct graph *graph, int t);
+double parallel_stable_matching(struct graph *graph, int t);
+double parallel_stable_matching_fair(struct graph *graph, int t);
+double serial_stable_matching(struct graph *graph, int t);
+double serial_stable_matching_fair(struct graph *graph, int t);
 double stable_matching_height(struct graph *graph);
 double stable_matching_close(struct graph *graph);
 double stable_matching_close_height(struct graph *graph);
@@ -114,6 +169,7 @@ double update_stable_close_height(struct graph *graph, double z);
 
 void update_graph(int width, int length, struct graph *graph);
 void update_graph_waypoint_group(int width, int length,struct graph *graph);
+void predict_waypoint_group(int width, int length, struct graph *graph);
 void shift_index(struct graph *graph);
 void sort_height_index(struct graph *graph);
 void sort_stability(struct graph *graph);
@@ -123,10 +179,22 @@ void reset_match(struct graph *graph);
 void reset(struct graph *graph);
 
 double maximal_matching(struct graph *graph, int t);
+double maximal_matching_hk(struct graph *graph, int t);
 double update_perfect(struct graph *graph, int t);
+double update_perfect_hk(struct graph *graph, int t);
+double update_perfect_dynamic(struct graph *graph, int t);
 double update_perfect_stable(struct graph *graph, int t);
+double update_perfect_stable_dynamic(struct graph *graph, int t);
+double b_matching(struct graph *graph, unsigned int b, int t);
+double relay_routing(struct graph *graph, int depth, int capacity, int t);
+double blossom_matching(struct graph *graph, int t);
+double weighted_matching(struct graph *graph, int t);
+double update_weighted(struct graph *graph, int t);
+double auction_matching(struct graph *graph, int t);
+double weighted_gap(struct graph *graph);
 
 double get_stability(struct graph *graph);
+void begin_timestep(struct graph *graph, int t);
 double calc_stability(struct graph *graph, int t);
 double get_jain(struct graph *graph);
 double get_stabl(struct graph *graph);
@@ -135,8 +203,18 @@ void update_capacity_delay_stationary(struct graph *graph, int t);
 void update_capacity_delay(struct graph *graph, int t);
 double get_capacity(struct graph *graph);
 double get_delay(struct graph *graph);
+void add_ap_stats(struct graph *graph, int t, double capacity[MAX_AP], double served[MAX_AP]);
 
 void init_stat(struct stat *stat);
 void save_stat(struct graph *graph, struct stat *stat);
+void init_series(struct series *series, int timestep);
+void add_series(struct series *series, int t, double value);
+void write_series(FILE *out, struct series *series, double div, double unit);
+void init_trace(struct trace *trace);
+void record_step(struct trace *trace, struct graph *graph, int t);
+int trace_reroutes(struct trace *trace);
+int matcher_reroutes(struct trace *trace);
+int optimal_reroutes(struct trace *trace);
+void solve_traces(struct trace *trace, int n, int *opt);
 
 #endif /* sim_h */